@@ -0,0 +1,104 @@
+#include "DistanceMatrix.hh"
+#include "Point.hh"
+#include <cstdint>
+using namespace std;
+
+
+// The size of a cache line, in doubles.
+const int CACHE_LINE_DOUBLES = 64 / sizeof(double);
+
+// Fills in the table from the points.  Each distance is exactly what
+// distanceTo returns, so lengths summed from the table match lengths
+// summed from the points.  Too many points for a table are just copied.
+DistanceMatrix::DistanceMatrix(const vector<Point> &points) {
+  numPoints = points.size();
+  stride = (numPoints + CACHE_LINE_DOUBLES - 1) / CACHE_LINE_DOUBLES *
+    CACHE_LINE_DOUBLES;
+
+  if (numPoints > MAX_TABLE_POINTS) {
+    storage = nullptr;
+    rows = nullptr;
+    this->points = new Point[numPoints];
+    for (int i = 0; i < numPoints; i++) {
+      this->points[i] = points[i];
+    }
+    return;
+  }
+  this->points = nullptr;
+
+  storage = new double[numPoints * stride + CACHE_LINE_DOUBLES];
+  uintptr_t address = (uintptr_t) storage;
+  uintptr_t aligned = (address + 63) & ~(uintptr_t) 63;
+  rows = storage + (aligned - address) / sizeof(double);
+
+  for (size_t i = 0; i < (size_t) numPoints; i++) {
+    for (size_t j = 0; j < (size_t) numPoints; j++) {
+      rows[i * stride + j] = points[i].distanceTo(points[j]);
+    }
+  }
+}
+
+// Looks up a distance when there is no table.
+double DistanceMatrix::distanceFromPoints(int i, int j) const {
+  return points[i].distanceTo(points[j]);
+}
+
+// The circuits are done four at a time, with the four sums kept apart, so
+// the loads for one circuit do not wait on the additions for another.
+void DistanceMatrix::circuitLengths(const int * const *circuits,
+                                    int numCircuits, int numVisits,
+                                    double *lengths) const {
+  if (numVisits <= 0) {
+    for (int k = 0; k < numCircuits; k++) {
+      lengths[k] = 0;
+    }
+    return;
+  }
+
+  if (rows == nullptr) {
+    for (int k = 0; k < numCircuits; k++) {
+      const int *c = circuits[k];
+      double sum = 0;
+      for (int i = 0; i < numVisits - 1; i++) {
+        sum += distanceFromPoints(c[i], c[i + 1]);
+      }
+      lengths[k] = sum + distanceFromPoints(c[numVisits - 1], c[0]);
+    }
+    return;
+  }
+
+  int k = 0;
+  for (; k + 4 <= numCircuits; k += 4) {
+    const int *c0 = circuits[k];
+    const int *c1 = circuits[k + 1];
+    const int *c2 = circuits[k + 2];
+    const int *c3 = circuits[k + 3];
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for (int i = 0; i < numVisits - 1; i++) {
+      sum0 += rows[c0[i] * stride + c0[i + 1]];
+      sum1 += rows[c1[i] * stride + c1[i + 1]];
+      sum2 += rows[c2[i] * stride + c2[i + 1]];
+      sum3 += rows[c3[i] * stride + c3[i + 1]];
+    }
+    int last = numVisits - 1;
+    lengths[k] = sum0 + rows[c0[last] * stride + c0[0]];
+    lengths[k + 1] = sum1 + rows[c1[last] * stride + c1[0]];
+    lengths[k + 2] = sum2 + rows[c2[last] * stride + c2[0]];
+    lengths[k + 3] = sum3 + rows[c3[last] * stride + c3[0]];
+  }
+
+  for (; k < numCircuits; k++) {
+    const int *c = circuits[k];
+    double sum = 0;
+    for (int i = 0; i < numVisits - 1; i++) {
+      sum += rows[c[i] * stride + c[i + 1]];
+    }
+    lengths[k] = sum + rows[c[numVisits - 1] * stride + c[0]];
+  }
+}
+
+// Destructor - frees the table, or the points.
+DistanceMatrix::~DistanceMatrix() {
+  delete[] storage;
+  delete[] points;
+}
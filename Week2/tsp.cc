@@ -1,70 +1,809 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <thread>
 #include <vector>
 #include "Point.hh"
+#include "DistanceMatrix.hh"
+#include "PointLoader.hh"
 using namespace std;
 
+/*
+ * The largest number of points the Held-Karp solver accepts. Its cost table
+ * has (n - 1) * 2^(n - 2) doubles, about 180 MB at this size, and doubles
+ * with every extra point.
+ */
+const int HELD_KARP_MAX_POINTS = 22;
+
+/*
+ * The number of subgradient steps branch and bound takes on the penalties
+ * at every node of its search.
+ */
+const int TIGHTEN_STEPS = 10;
+
+/*
+ * The largest number of points the brute-force search accepts, which tries
+ * (n - 1)! / 2 circuits; at this size that is about 240 million.
+ */
+const int BRUTE_FORCE_MAX_POINTS = 13;
+
 /* 
  * This function computes the length of the circuit. The circuit is given by
- * the points inputted in the points vector in the order specified by the 
- * inputted order vector. This uses the distanceTo function from the Point
- * class written last week. It includes the distance from the last point back
- * to the first.
+ * the points in the distance matrix, in the order specified by the 
+ * inputted order vector. The distances between the points are looked up in
+ * the matrix rather than worked out again. It includes the distance from
+ * the last point back to the first.
  * The function returns a double representing the total distance.
  */
 
-double circuitLength(const vector<Point> &points, const vector<int> &order) {
+double circuitLength(const DistanceMatrix &dist, const vector<int> &order) {
     double totalDistance = 0;
     for(int i = 0; i < order.size() - 1; i++) {
-        Point p1 = points[order[i]];
-        Point p2 = points[order[i+1]];
-        totalDistance += p1.distanceTo(p2);
+        totalDistance += dist.get(order[i], order[i+1]);
     }
 
-    totalDistance += points[order[order.size() - 1]].distanceTo(
-        points[order[0]]);
+    totalDistance += dist.get(order[order.size() - 1], order[0]);
     return totalDistance;
 }
 
-/* 
- * This function computes the shortestPath of the given points. 
- * This is done by running through every possible permutation of the points 
- * and checking if the circuitLength of that particular order is the minimum.
- * If it is, the order is saved and returned.
+/*
+ * The state of a search through every tour, shared by the threads that run
+ * it. Subtrees of the search are numbered in lexicographic order of their
+ * prefixes, and handed out in that order. The bound is the shortest circuit
+ * any thread has found so far.
  */
 
-vector<int> findShortestPath(const vector<Point> &points) {
-    double minLength = 100000000;
-    double tempLength = 0;
-    vector<int> savedOrder;
+struct PermutationSearch {
+    int n;
+    int prefixLength;
+    const DistanceMatrix *dist;
+    vector<vector<int>> prefixes;
+    atomic<int> nextSubtree;
+    atomic<double> bound;
+};
 
+/*
+ * The best circuit one thread has found, and the subtree it was found in.
+ */
+
+struct PermutationBest {
+    double length;
+    int subtree;
     vector<int> order;
+};
+
+/*
+ * This function lowers the shared bound to length, unless another thread
+ * has already lowered it further.
+ */
+
+void lowerBound(PermutationSearch &search, double length) {
+    double current = search.bound.load(memory_order_relaxed);
+    while(length < current &&
+          !search.bound.compare_exchange_weak(current, length,
+                                              memory_order_relaxed)) {
+    }
+}
+
+/*
+ * This function tries every way of finishing order, whose first depth
+ * entries are fixed and add up to prefixSum, in lexicographic order. Each
+ * point added costs one distance, and the lengths are summed in the same
+ * order as circuitLength, so they come out exactly the same. Every tour is
+ * also found backwards, so only the direction whose second point is smaller
+ * than its last is tried: largerLeft counts the unused points larger than
+ * the second, and once none is left to come last, the branch is cut.
+ *
+ * Partial sums only grow, so once one is above the shared bound, nothing
+ * under it can be the shortest and it is skipped; equal lengths are kept,
+ * since the earliest of them is the one to return.
+ */
+
+void searchPermutations(PermutationSearch &search, PermutationBest &best,
+                        int subtree, vector<int> &order, vector<bool> &used,
+                        int depth, double prefixSum, int largerLeft) {
+    int n = search.n;
+    const DistanceMatrix &dist = *search.dist;
+
+    if(prefixSum > search.bound.load(memory_order_relaxed)) {
+        return;
+    }
+    if(depth >= 2 && depth < n && largerLeft == 0) {
+        return;
+    }
+    if(depth == n) {
+        double length = prefixSum + dist.get(order[n - 1], order[0]);
+        if(length < best.length) {
+            best.length = length;
+            best.subtree = subtree;
+            best.order = order;
+            lowerBound(search, length);
+        }
+        return;
+    }
+
+    const double *from = dist.row(order[depth - 1]);
+    for(int i = 0; i < n; i++) {
+        if(used[i]) {
+            continue;
+        }
+        // Points larger than the second stop counting once they are placed.
+        int left = depth == 1 ? n - 1 - i : largerLeft - (i > order[1]);
+        used[i] = true;
+        order[depth] = i;
+        searchPermutations(search, best, subtree, order, used, depth + 1,
+                           prefixSum + from[i], left);
+        used[i] = false;
+    }
+}
+
+/*
+ * This function is run by each thread of a search. It takes subtrees in
+ * increasing order until there are none left, so its own best, which only
+ * strictly shorter circuits replace, is always the earliest of its
+ * shortest.
+ */
+
+void permutationWorker(PermutationSearch &search, PermutationBest &best) {
+    int n = search.n;
+    vector<int> order(n);
+    vector<bool> used(n);
+
+    while(true) {
+        int subtree = search.nextSubtree.fetch_add(1);
+        if(subtree >= (int) search.prefixes.size()) {
+            break;
+        }
+
+        const vector<int> &prefix = search.prefixes[subtree];
+        fill(used.begin(), used.end(), false);
+        double prefixSum = 0;
+        for(int i = 0; i < search.prefixLength; i++) {
+            order[i] = prefix[i];
+            used[prefix[i]] = true;
+            if(i > 0) {
+                prefixSum += search.dist->get(prefix[i - 1], prefix[i]);
+            }
+        }
+        int largerLeft = 0;
+        for(int j = 0; search.prefixLength >= 2 && j < n; j++) {
+            if(!used[j] && j > order[1]) {
+                largerLeft++;
+            }
+        }
+        searchPermutations(search, best, subtree, order, used,
+                           search.prefixLength, prefixSum, largerLeft);
+    }
+}
+
+/*
+ * This function prepares a search of the tours through the points in dist.
+ * It has no subtrees yet.
+ */
+
+void startPermutationSearch(PermutationSearch &search,
+                            const DistanceMatrix &dist, int prefixLength) {
+    search.n = dist.size();
+    search.prefixLength = prefixLength;
+    search.dist = &dist;
+    search.nextSubtree = 0;
+    search.bound = 100000000;
+}
+
+/* 
+ * This function computes the shortestPath of the points in dist. 
+ * A circuit is the same wherever it starts and in whichever direction it
+ * goes, so only circuits starting at point 0, in the direction whose second
+ * point is smaller than its last, are tried: (n - 1)! / 2 of them instead
+ * of n!. They are built up one point at a time, keeping the length so far,
+ * and the first of the shortest in lexicographic order is returned.
+ */
+
+vector<int> findShortestPath(const DistanceMatrix &dist) {
+    int n = dist.size();
+    if(n <= 3) {
+        vector<int> order;
+        for(int i = 0; i < n; i++) {
+            order.push_back(i);
+        }
+        return order;
+    }
+
+    PermutationSearch search;
+    startPermutationSearch(search, dist, 1);
+    search.prefixes.push_back({0});
+
+    PermutationBest best;
+    best.length = 100000000;
+    best.subtree = -1;
+    permutationWorker(search, best);
+    return best.order;
+}
 
-    for(int i = 0; i < points.size(); i++) {
+/* 
+ * This function computes the same shortest path as findShortestPath, using
+ * every core. The circuits are split into subtrees by their second and
+ * third points, which the threads take in turn. Each thread keeps its own best,
+ * and they share the length of the shortest circuit found so far to skip
+ * permutations that are already too long part way through. Of the
+ * circuits with the shortest length, the one that comes first in
+ * lexicographic order is returned, as findShortestPath does.
+ */
+
+vector<int> findShortestPathParallel(const DistanceMatrix &dist) {
+    int n = dist.size();
+    if(n <= 3) {
+        return findShortestPath(dist);
+    }
+
+    PermutationSearch search;
+    startPermutationSearch(search, dist, 3);
+    // A second point of n - 1 would leave no larger point to end on.
+    for(int i = 1; i < n - 1; i++) {
+        for(int j = 1; j < n; j++) {
+            if(i != j) {
+                search.prefixes.push_back({0, i, j});
+            }
+        }
+    }
+
+    int numThreads = max(1u, thread::hardware_concurrency());
+    numThreads = min(numThreads, (int) search.prefixes.size());
+    vector<PermutationBest> bests(numThreads);
+    vector<thread> threads;
+    for(int t = 0; t < numThreads; t++) {
+        bests[t].length = 100000000;
+        bests[t].subtree = -1;
+        threads.push_back(thread(permutationWorker, ref(search),
+                                 ref(bests[t])));
+    }
+
+    PermutationBest *best = nullptr;
+    for(int t = 0; t < numThreads; t++) {
+        threads[t].join();
+        if(bests[t].subtree == -1) {
+            continue;
+        }
+        if(best == nullptr || bests[t].length < best->length ||
+           (bests[t].length == best->length &&
+            bests[t].subtree < best->subtree)) {
+            best = &bests[t];
+        }
+    }
+
+    return best != nullptr ? best->order : vector<int>();
+}
+
+/* 
+ * This function computes the shortest path exactly with the Held-Karp
+ * dynamic program, in O(n^2 * 2^n) time instead of the O(n!) of trying
+ * every permutation. The tour starts at point 0. For every subset S of the
+ * other points and every point j in S, the table holds the length of the
+ * shortest path that starts at point 0, visits exactly the points in S, and
+ * ends at j. Each entry is found from the entries for S without j, so the
+ * subsets are filled in in increasing order.
+ *
+ * The table is stored compactly: each subset has one entry per point it
+ * contains, and the entries of each subset are contiguous, so each step
+ * reads one short run of memory. Instead of a parent table, the path is
+ * reconstructed by repeating the minimizing step for each entry on it.
+ * The lengths are doubles added up in the same order as circuitLength, and
+ * rounding never reverses the order of two sums with the same last edge,
+ * so the tour returned is the shortest as circuitLength measures it. The
+ * order is returned in the same form as findShortestPath.
+ */
+
+vector<int> findShortestPathHeldKarp(const DistanceMatrix &dist) {
+    int n = dist.size();
+    vector<int> order;
+    for(int i = 0; i < n; i++) {
         order.push_back(i);
     }
+    if(n <= 3) {
+        return order;
+    }
+
+    // Points 1..n-1 are numbered 0..m-1 within the subsets.
+    int m = n - 1;
+    uint32_t numSubsets = (uint32_t) 1 << m;
+
+    // offset[S] is where subset S's entries begin.
+    vector<uint32_t> offset(numSubsets + 1);
+    offset[0] = 0;
+    for(uint32_t s = 0; s < numSubsets; s++) {
+        offset[s + 1] = offset[s] + __builtin_popcount(s);
+    }
+    vector<double> cost(offset[numSubsets]);
 
-    do {
-        tempLength = circuitLength(points, order);
-        if (tempLength < minLength) {
-            minLength = tempLength;
-            savedOrder = order;
+    for(uint32_t s = 1; s < numSubsets; s++) {
+        double *entry = &cost[offset[s]];
+        for(int j = 0; j < m; j++) {
+            if(!(s & (1u << j))) {
+                continue;
+            }
+
+            uint32_t prev = s & ~(1u << j);
+            if(prev == 0) {
+                *entry++ = dist.get(0, j + 1);
+                continue;
+            }
+
+            // The entries for prev are in the same order as its points.
+            const double *prevEntry = &cost[offset[prev]];
+            double best = 0;
+            bool found = false;
+            for(int k = 0; k < m; k++) {
+                if(!(prev & (1u << k))) {
+                    continue;
+                }
+                double length = *prevEntry++ + dist.get(k + 1, j + 1);
+                if(!found || length < best) {
+                    best = length;
+                    found = true;
+                }
+            }
+            *entry++ = best;
+        }
+    }
+
+    // Close the tour, then walk back through the table.
+    uint32_t s = numSubsets - 1;
+    int last = 0;
+    double best = 0;
+    for(int j = 0; j < m; j++) {
+        double length = cost[offset[s] + j] + dist.get(j + 1, 0);
+        if(j == 0 || length < best) {
+            best = length;
+            last = j;
+        }
+    }
+
+    for(int pos = n - 1; pos >= 1; pos--) {
+        order[pos] = last + 1;
+        uint32_t prev = s & ~(1u << last);
+        if(prev == 0) {
+            break;
+        }
+
+        const double *prevEntry = &cost[offset[prev]];
+        int bestK = -1;
+        for(int k = 0; k < m; k++) {
+            if(!(prev & (1u << k))) {
+                continue;
+            }
+            double length = *prevEntry++ + dist.get(k + 1, last + 1);
+            if(bestK == -1 || length < best) {
+                best = length;
+                bestK = k;
+            }
         }
-    } while(next_permutation(order.begin(), order.end()));
 
-    return savedOrder;
+        s = prev;
+        last = bestK;
+    }
+    order[0] = 0;
 
+    return order;
 }
 
 /* 
- * The main function fills the points vector with inputted points.
- * It then calls the findShortestPath function to get the bestOrder.
- * It then uses this order and the vector of points to get the circuit
+ * This function builds a good tour quickly, to give the branch-and-bound
+ * search a tight bound from the start. It visits the nearest unvisited point
+ * at each step, then improves the tour with 2-opt moves (reversing a section
+ * when that shortens it) until no move helps.
+ */
+
+vector<int> heuristicTour(const DistanceMatrix &dist) {
+    int n = dist.size();
+    vector<int> order;
+    vector<bool> visited(n, false);
+    order.push_back(0);
+    visited[0] = true;
+    for(int step = 1; step < n; step++) {
+        int cur = order.back();
+        int next = -1;
+        for(int j = 0; j < n; j++) {
+            if(!visited[j] &&
+               (next == -1 || dist.get(cur, j) < dist.get(cur, next))) {
+                next = j;
+            }
+        }
+        order.push_back(next);
+        visited[next] = true;
+    }
+
+    bool improved = true;
+    while(improved) {
+        improved = false;
+        for(int i = 1; i < n - 1; i++) {
+            for(int j = i + 1; j < n; j++) {
+                int a = order[i - 1], b = order[i];
+                int c = order[j], d = order[(j + 1) % n];
+                double delta = dist.get(a, c) + dist.get(b, d) -
+                    dist.get(a, b) - dist.get(c, d);
+                if(delta < -1e-9) {
+                    reverse(order.begin() + i, order.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+    }
+    return order;
+}
+
+/*
+ * The state of a branch-and-bound search: the partial tour being extended,
+ * and the best complete tour found so far.
+ */
+
+struct BranchAndBound {
+    int n;
+    const DistanceMatrix *dist;
+    vector<double> penalty;     // node penalties for the 1-tree bound
+    vector<int> path;
+    vector<bool> visited;
+    double bestLength;
+    vector<int> bestOrder;
+    long nodes;
+    vector<double> key;         // scratch space for the spanning tree
+    vector<bool> inTree;
+};
+
+/*
+ * This function returns the length of a minimum spanning tree over the
+ * points not in bb.visited, measured with the penalized distances
+ * dist(i, j) + penalty(i) + penalty(j), using Prim's algorithm. The degree
+ * of every point in the tree is added to degree, if it is not null.
+ */
+
+double penalizedTree(BranchAndBound &bb, vector<int> *degree) {
+    int n = bb.n;
+    const DistanceMatrix &dist = *bb.dist;
+    const double *penalty = bb.penalty.data();
+    vector<int> parent(degree != nullptr ? n : 0);
+
+    int first = -1;
+    for(int j = 0; j < n; j++) {
+        bb.inTree[j] = bb.visited[j];
+        bb.key[j] = 1e300;
+        if(!bb.visited[j] && first == -1) {
+            first = j;
+        }
+    }
+    if(first == -1) {
+        return 0;
+    }
+
+    double tree = 0;
+    int added = first;
+    bb.inTree[added] = true;
+    while(true) {
+        const double *from = dist.row(added);
+        int next = -1;
+        for(int j = 0; j < n; j++) {
+            if(bb.inTree[j]) {
+                continue;
+            }
+            double d = from[j] + penalty[added] + penalty[j];
+            if(d < bb.key[j]) {
+                bb.key[j] = d;
+                if(degree != nullptr) {
+                    parent[j] = added;
+                }
+            }
+            if(next == -1 || bb.key[j] < bb.key[next]) {
+                next = j;
+            }
+        }
+        if(next == -1) {
+            break;
+        }
+        tree += bb.key[next];
+        bb.inTree[next] = true;
+        if(degree != nullptr) {
+            (*degree)[next]++;
+            (*degree)[parent[next]]++;
+        }
+        added = next;
+    }
+    return tree;
+}
+
+/*
+ * This function returns a lower bound on the length of any way to finish
+ * the partial tour, which must go from its last point cur through every
+ * unvisited point and back to point 0. Such a path is an edge from cur into
+ * the unvisited points, a path through all of them (which is at least as
+ * long as their minimum spanning tree), and an edge back to 0. The degree
+ * of every unvisited point in that structure is added to degree, if it is
+ * not null.
+ *
+ * The bound is computed with penalized distances, which add penalty(i) to
+ * every edge at point i. On the remaining path, cur and 0 have one edge and
+ * every unvisited point two, so its penalized length is its real length
+ * plus a known constant; the bound on the penalized length, minus that
+ * constant, is still a bound on the real length, and a much tighter one
+ * when the penalties come from penalize() and tighten().
+ */
+
+double remainingBound(BranchAndBound &bb, int cur, vector<int> *degree) {
+    int n = bb.n;
+    const DistanceMatrix &dist = *bb.dist;
+    const double *penalty = bb.penalty.data();
+
+    // Penalized distances can be negative, so they start out huge.
+    double toCur = 1e300, toStart = 1e300;
+    int nearCur = -1, nearStart = -1;
+    double penalties = penalty[cur] + penalty[0];
+    for(int j = 0; j < n; j++) {
+        if(bb.visited[j]) {
+            continue;
+        }
+        double d = dist.get(cur, j) + penalty[cur] + penalty[j];
+        if(d < toCur) {
+            toCur = d;
+            nearCur = j;
+        }
+        d = dist.get(0, j) + penalty[0] + penalty[j];
+        if(d < toStart) {
+            toStart = d;
+            nearStart = j;
+        }
+        penalties += 2 * penalty[j];
+    }
+    if(nearCur == -1) {
+        return dist.get(cur, 0);
+    }
+
+    double tree = penalizedTree(bb, degree);
+    if(degree != nullptr) {
+        (*degree)[nearCur]++;
+        (*degree)[nearStart]++;
+    }
+    return toCur + tree + toStart - penalties;
+}
+
+/*
+ * This function raises the bound of remainingBound() for the partial tour
+ * in bb.path, whose length is length, by a few subgradient steps on the
+ * penalties of the unvisited points, as Volgenant and Jonker do at every
+ * node of their search. Once points are visited, the root's penalties no
+ * longer fit what is left, and the bound falls behind; starting from the
+ * parent's penalties, a few steps are enough to catch up. The best
+ * penalties found are left in bb.penalty for the children, and the best
+ * bound is returned. It stops early once the bound prunes the node.
+ */
+
+double tighten(BranchAndBound &bb, double length) {
+    int n = bb.n;
+    int cur = bb.path.back();
+    vector<int> degree(n);
+    vector<double> bestPenalty;
+    double bestBound = -1e300;
+    double step = 1;
+
+    for(int iter = 0; iter < TIGHTEN_STEPS; iter++) {
+        degree.assign(n, 0);
+        double bound = remainingBound(bb, cur, &degree);
+        if(bound > bestBound) {
+            bestBound = bound;
+            bestPenalty = bb.penalty;
+        }
+        else {
+            step /= 2;
+        }
+        if(length + bestBound >= bb.bestLength) {
+            break;
+        }
+
+        int norm = 0;
+        for(int j = 0; j < n; j++) {
+            if(!bb.visited[j]) {
+                norm += (degree[j] - 2) * (degree[j] - 2);
+            }
+        }
+        if(norm == 0) {
+            break;   // the bound is a path, so it is exact
+        }
+
+        double t = step * (bb.bestLength - length - bound) / norm;
+        for(int j = 0; j < n; j++) {
+            if(!bb.visited[j]) {
+                bb.penalty[j] += t * (degree[j] - 2);
+            }
+        }
+    }
+
+    bb.penalty = bestPenalty;
+    return bestBound;
+}
+
+/*
+ * This function chooses the penalties for remainingBound() by subgradient
+ * optimization of the Held-Karp 1-tree bound at the root of the search.
+ * A 1-tree is a spanning tree of points 1..n-1 plus the two shortest edges
+ * from point 0; every tour is a 1-tree in which each point has degree 2.
+ * Points of higher degree in the minimum 1-tree have their penalties raised,
+ * and points of degree 1 lowered, which pushes the tree toward a tour and
+ * its length up toward the optimal tour length.
+ */
+
+void penalize(BranchAndBound &bb) {
+    int n = bb.n;
+    const double *fromStart = bb.dist->row(0);
+    bb.penalty.assign(n, 0);
+    vector<double> bestPenalty(bb.penalty);
+    double bestBound = 0;
+    double step = 2;
+
+    for(int iter = 0, stale = 0; iter < 50 * n && step > 1e-4; iter++) {
+        vector<int> degree(n, 0);
+        bb.visited[0] = true;
+        double tree = penalizedTree(bb, &degree);
+        bb.visited[0] = false;
+
+        // The two shortest penalized edges from point 0.
+        int a = -1, b = -1;
+        for(int j = 1; j < n; j++) {
+            double d = fromStart[j] + bb.penalty[0] + bb.penalty[j];
+            if(a == -1 || d < fromStart[a] + bb.penalty[0] + bb.penalty[a]) {
+                b = a;
+                a = j;
+            }
+            else if(b == -1 ||
+                    d < fromStart[b] + bb.penalty[0] + bb.penalty[b]) {
+                b = j;
+            }
+        }
+        degree[0] = 2;
+        degree[a]++;
+        degree[b]++;
+        tree += fromStart[a] + fromStart[b] + 2 * bb.penalty[0] +
+            bb.penalty[a] + bb.penalty[b];
+
+        double sum = 0;
+        int norm = 0;
+        for(int j = 0; j < n; j++) {
+            sum += bb.penalty[j];
+            norm += (degree[j] - 2) * (degree[j] - 2);
+        }
+        double bound = tree - 2 * sum;
+
+        if(bound > bestBound) {
+            bestBound = bound;
+            bestPenalty = bb.penalty;
+            stale = 0;
+        }
+        else if(++stale >= n / 2 + 5) {
+            step /= 2;
+            stale = 0;
+        }
+        if(norm == 0) {
+            break;   // the 1-tree is a tour, so it is optimal
+        }
+
+        double t = step * (bb.bestLength - bound) / norm;
+        for(int j = 0; j < n; j++) {
+            bb.penalty[j] += t * (degree[j] - 2);
+        }
+    }
+
+    bb.penalty = bestPenalty;
+}
+
+/*
+ * This function extends the partial tour in bb.path, whose length is
+ * length, in every way that could still beat the best tour found so far.
+ * Nearer points are tried first, so good tours are found early and prune
+ * more of the search.
+ */
+
+void branch(BranchAndBound &bb, double length) {
+    bb.nodes++;
+    int n = bb.n;
+    int cur = bb.path.back();
+
+    if((int) bb.path.size() == n) {
+        double total = length + bb.dist->get(cur, 0);
+        if(total < bb.bestLength) {
+            bb.bestLength = total;
+            bb.bestOrder = bb.path;
+        }
+        return;
+    }
+
+    if(length + tighten(bb, length) >= bb.bestLength) {
+        return;
+    }
+    vector<double> penalty(bb.penalty);
+
+    vector<int> children;
+    for(int j = 0; j < n; j++) {
+        if(!bb.visited[j]) {
+            children.push_back(j);
+        }
+    }
+    const double *fromCur = bb.dist->row(cur);
+    sort(children.begin(), children.end(), [&](int a, int b) {
+        return fromCur[a] < fromCur[b];
+    });
+
+    for(int j : children) {
+        double extended = length + fromCur[j];
+        if(extended >= bb.bestLength) {
+            continue;
+        }
+        bb.visited[j] = true;
+        bb.path.push_back(j);
+        branch(bb, extended);
+        bb.path.pop_back();
+        bb.visited[j] = false;
+        bb.penalty = penalty;
+    }
+}
+
+/* 
+ * This function computes the shortest path exactly by depth-first branch
+ * and bound, for instances too large for Held-Karp's memory. Partial tours
+ * starting at point 0 are extended one point at a time, and a partial tour
+ * is abandoned as soon as its length plus a lower bound on the rest is no
+ * better than the best complete tour so far, which starts out as a 2-opt
+ * tour. The lower bound is a penalized spanning tree, as in the Held-Karp
+ * 1-tree bound, with penalties optimized at the root and refined at every
+ * node. Uniform random instances of 60 points usually take a few seconds,
+ * but the time grows exponentially and varies widely from one instance to
+ * the next. The number of search nodes explored is stored in
+ * nodesExplored. The order is returned in the same form as findShortestPath.
+ */
+
+vector<int> findShortestPathBranchAndBound(const DistanceMatrix &dist,
+                                           long &nodesExplored) {
+    BranchAndBound bb;
+    int n = dist.size();
+    bb.n = n;
+    bb.nodes = 0;
+    nodesExplored = 0;
+    if(n <= 3) {
+        for(int i = 0; i < n; i++) {
+            bb.bestOrder.push_back(i);
+        }
+        return bb.bestOrder;
+    }
+
+    bb.dist = &dist;
+    bb.key.resize(n);
+    bb.inTree.resize(n);
+    bb.visited.assign(n, false);
+
+    bb.bestOrder = heuristicTour(dist);
+    bb.bestLength = circuitLength(dist, bb.bestOrder);
+    // Only strictly shorter tours replace the heuristic one, so allow for
+    // rounding in its length.
+    bb.bestLength += 1e-9 * bb.bestLength;
+
+    penalize(bb);
+
+    bb.path.push_back(0);
+    bb.visited[0] = true;
+    branch(bb, 0);
+
+    nodesExplored = bb.nodes;
+    return bb.bestOrder;
+}
+
+/* 
+ * The main function fills the points vector with inputted points, and
+ * works out the distances between them once for every solver. It then calls the findShortestPath function to get the bestOrder.
+ * Given --brute-force, it tries every circuit on every core instead, which
+ * is only feasible for a few points but is a check on the other solvers.
+ * It then uses this order and the distances to get the circuit
  * Length of the best Order. This information is printed in the format
  * designated in the problem set.
  */
  
-int main()
+int main(int argc, char **argv)
 {
     int numPoints;
     double coord1; 
@@ -73,23 +812,70 @@ int main()
     vector<Point> points;
     vector<int> bestOrder;
 
-    cout  << "How many points? ";
-    cin >> numPoints;
+    bool bruteForce = argc > 1 && string(argv[1]) == "--brute-force";
+    if(bruteForce) {
+        argc--;
+        argv++;
+    }
+
+    /*
+     * The points are read from the file named on the command line, if there
+     * is one, without any prompts. Otherwise they are asked for one by one.
+     */
+    if(argc > 1) {
+        string error;
+        if(!loadPoints(argv[1], PointFormat::AUTO, points, error)) {
+            cerr << error << endl;
+            return 1;
+        }
+        numPoints = points.size();
+    }
+    else {
+        cout  << "How many points? ";
+        cin >> numPoints;
 
-    for(int i = 0; i < numPoints; i++) {
-        cout << "Point " << i << ": ";
-        cin >> coord1 >> coord2 >> coord3;
-        Point p = Point(coord1, coord2, coord3);
-        points.push_back(p);
+        for(int i = 0; i < numPoints; i++) {
+            cout << "Point " << i << ": ";
+            cin >> coord1 >> coord2 >> coord3;
+            Point p = Point(coord1, coord2, coord3);
+            points.push_back(p);
+        }
     }
     
-    bestOrder = findShortestPath(points);
+    DistanceMatrix dist(points);
+    if(bruteForce) {
+        if(numPoints > BRUTE_FORCE_MAX_POINTS) {
+            cerr << "Brute force is limited to " << BRUTE_FORCE_MAX_POINTS
+                 << " points" << endl;
+            return 1;
+        }
+        bestOrder = findShortestPathParallel(dist);
+    }
+    else if(numPoints <= HELD_KARP_MAX_POINTS) {
+        bestOrder = findShortestPathHeldKarp(dist);
+    }
+    else {
+        // The search walks whole rows of the distance table.
+        if(!dist.hasTable()) {
+            cerr << "Branch and bound is limited to "
+                 << DistanceMatrix::MAX_TABLE_POINTS << " points" << endl;
+            return 1;
+        }
+        long nodes;
+        auto start = chrono::steady_clock::now();
+        bestOrder = findShortestPathBranchAndBound(dist, nodes);
+        double seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+        cerr << "Branch and bound explored " << nodes << " nodes in "
+             << seconds << " s (" << (long) (nodes / max(seconds, 1e-9))
+             << " nodes/s)" << endl;
+    }
     cout << "Best Order: [";
     for(int i = 0; i < bestOrder.size(); i++) {
         cout << bestOrder[i] << " ";
     }
     cout << "]" << endl;
 
-    cout << "Shortest distance: " << circuitLength(points, bestOrder) << endl;
+    cout << "Shortest distance: " << circuitLength(dist, bestOrder) << endl;
 
 }
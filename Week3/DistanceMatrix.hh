@@ -0,0 +1,64 @@
+#ifndef DISTANCEMATRIX_HH
+#define DISTANCEMATRIX_HH
+
+#include <cstddef>
+#include <vector>
+
+class Point;
+
+// The distances between every pair of a fixed set of points, worked out
+// once so that looking one up is a single load.  The table is one flat
+// array, with each row padded to a whole number of 64-byte cache lines
+// and starting on a cache line of its own.  Above MAX_TABLE_POINTS points
+// there is no table, and each distance is worked out from the points when
+// it is looked up.
+class DistanceMatrix {
+
+private:
+  int numPoints;
+  // Doubles from the start of one row to the next.  It is a size_t so
+  // that offsets into the table, which pass 2^31 at about 46,000 points,
+  // are worked out without overflowing.
+  size_t stride;
+  double *storage;        // the allocation, before alignment
+  double *rows;           // null when there is no table
+  Point *points;          // a copy of the points, only when there is no table
+
+  // The table is not copyable.
+  DistanceMatrix(const DistanceMatrix &);
+  DistanceMatrix & operator=(const DistanceMatrix &);
+
+  double distanceFromPoints(int i, int j) const;
+
+public:
+  // The most points with a table, which then takes 2 GiB.
+  static const int MAX_TABLE_POINTS = 16384;
+
+  // Constructor
+  DistanceMatrix(const std::vector<Point> &points);
+
+  // Destructor
+  ~DistanceMatrix();
+
+  // Accessor methods
+  int size() const { return numPoints; }
+
+  bool hasTable() const { return rows != nullptr; }
+
+  double get(int i, int j) const {
+    return rows != nullptr ? rows[i * stride + j] : distanceFromPoints(i, j);
+  }
+
+  // The distances from point i to every point.  Only valid if hasTable().
+  const double * row(int i) const { return rows + i * stride; }
+
+  // Computes the length of numCircuits circuits at once, each visiting
+  // numVisits points in the order given by circuits[k], and stores them in
+  // lengths[k].  Each length is summed in order along the circuit, ending
+  // with the edge back to the start, so it is the same as adding up the
+  // edges one circuit at a time.
+  void circuitLengths(const int * const *circuits, int numCircuits,
+                      int numVisits, double *lengths) const;
+};
+
+#endif // DISTANCEMATRIX_HH
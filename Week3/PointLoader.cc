@@ -0,0 +1,257 @@
+#include "PointLoader.hh"
+#include "Point.hh"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+// Returns true if s ends with suffix.
+static bool endsWith(const string &s, const string &suffix) {
+  return s.size() >= suffix.size() &&
+    s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Works out the format of the file at path from its name.
+static PointFormat formatFromPath(const string &path) {
+  if (endsWith(path, ".tsp")) {
+    return PointFormat::TSPLIB;
+  }
+  if (endsWith(path, ".f32")) {
+    return PointFormat::FLOAT32;
+  }
+  if (endsWith(path, ".f64")) {
+    return PointFormat::FLOAT64;
+  }
+  return PointFormat::TEXT;
+}
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' ||
+    c == '\f';
+}
+
+// Skips any whitespace at p, then parses the number there and moves p past
+// it.  Returns false, leaving p at the bad text, if there is no number.
+template<typename T>
+static bool parseNumber(const char *&p, const char *end, T &value) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  if (p < end && *p == '+') {
+    p++;                  // from_chars does not take a leading plus
+  }
+  from_chars_result result = from_chars(p, end, value);
+  if (result.ec != errc()) {
+    return false;
+  }
+  p = result.ptr;
+  return true;
+}
+
+// Returns how many points could be left in the text from p to end, if each
+// takes at least minBytes bytes.  Space is only reserved for that many, so
+// that a bad count in a file cannot make it reserve too much.
+static long pointsThatFit(const char *p, const char *end, long minBytes) {
+  return (end - p) / minBytes;
+}
+
+// Parses the numbers of the TEXT format.
+static bool parseText(const char *p, const char *end, vector<Point> &points,
+                      string &error) {
+  long numPoints;
+  if (!parseNumber(p, end, numPoints) || numPoints < 0) {
+    error = "expected the number of points";
+    return false;
+  }
+
+  // Each point is at least three digits, each after some whitespace.
+  points.reserve(min(numPoints, pointsThatFit(p, end, 6)));
+  for (long i = 0; i < numPoints; i++) {
+    double x, y, z;
+    if (!parseNumber(p, end, x) || !parseNumber(p, end, y) ||
+        !parseNumber(p, end, z)) {
+      error = "expected three coordinates for point " + to_string(i);
+      return false;
+    }
+    points.emplace_back(x, y, z);
+  }
+  return true;
+}
+
+// Parses a TSPLIB file.  The header is a series of "KEY : VALUE" lines;
+// only DIMENSION and EDGE_WEIGHT_TYPE matter here.  Each line of the
+// NODE_COORD_SECTION that follows is a point's number, then its
+// coordinates.  Only the edge weight types that measure straight-line
+// distances are accepted, since those are the distances between the
+// points; GEO, ATT and the rest would give different tours.
+static bool parseTSPLIB(const char *p, const char *end,
+                        vector<Point> &points, string &error) {
+  long numPoints = -1;
+  int numCoords = 2;
+  bool foundSection = false;
+
+  while (p < end && !foundSection) {
+    const char *lineEnd = (const char *) memchr(p, '\n', end - p);
+    if (lineEnd == nullptr) {
+      lineEnd = end;
+    }
+    string line(p, lineEnd);
+    p = lineEnd < end ? lineEnd + 1 : end;
+
+    size_t colon = line.find(':');
+    string key = line.substr(0, colon);
+    string value = colon == string::npos ? "" : line.substr(colon + 1);
+    key.erase(0, key.find_first_not_of(" \t\r"));
+    key.erase(key.find_last_not_of(" \t\r") + 1);
+
+    if (key == "NODE_COORD_SECTION") {
+      foundSection = true;
+    }
+    else if (key == "DIMENSION") {
+      const char *v = value.data();
+      if (!parseNumber(v, v + value.size(), numPoints) || numPoints < 0) {
+        error = "bad DIMENSION";
+        return false;
+      }
+    }
+    else if (key == "EDGE_WEIGHT_TYPE") {
+      value.erase(0, value.find_first_not_of(" \t\r"));
+      value.erase(value.find_last_not_of(" \t\r") + 1);
+      if (value == "EUC_2D" || value == "CEIL_2D") {
+        numCoords = 2;
+      }
+      else if (value == "EUC_3D") {
+        numCoords = 3;
+      }
+      else {
+        error = "unsupported EDGE_WEIGHT_TYPE " + value;
+        return false;
+      }
+    }
+    else if (key == "EDGE_WEIGHT_SECTION") {
+      error = "only instances with node coordinates are supported";
+      return false;
+    }
+  }
+
+  if (!foundSection) {
+    error = "no NODE_COORD_SECTION";
+    return false;
+  }
+  if (numPoints == -1) {
+    error = "no DIMENSION";
+    return false;
+  }
+
+  // Each node is its number and two or three coordinates, each at least a
+  // digit after some whitespace.
+  points.reserve(min(numPoints, pointsThatFit(p, end, 2 * (1 + numCoords))));
+  for (long i = 0; i < numPoints; i++) {
+    long number;
+    double coords[3] = { 0, 0, 0 };
+    bool ok = parseNumber(p, end, number);
+    for (int c = 0; ok && c < numCoords; c++) {
+      ok = parseNumber(p, end, coords[c]);
+    }
+    if (!ok) {
+      error = "expected " + to_string(numPoints) + " nodes, found " +
+        to_string(i);
+      return false;
+    }
+    points.emplace_back(coords[0], coords[1], coords[2]);
+  }
+  return true;
+}
+
+// Copies raw x, y, z triples of type T into points.
+template<typename T>
+static bool parseBinary(const char *p, const char *end,
+                        vector<Point> &points, string &error) {
+  size_t size = end - p;
+  if (size % (3 * sizeof(T)) != 0) {
+    error = "size is not a whole number of points";
+    return false;
+  }
+
+  size_t numPoints = size / (3 * sizeof(T));
+  points.reserve(numPoints);
+  for (size_t i = 0; i < numPoints; i++) {
+    T coords[3];
+    memcpy(coords, p + i * sizeof(coords), sizeof(coords));
+    points.emplace_back(coords[0], coords[1], coords[2]);
+  }
+  return true;
+}
+
+bool loadPoints(const string &path, PointFormat format,
+                vector<Point> &points, string &error) {
+  points.clear();
+  if (format == PointFormat::AUTO) {
+    format = formatFromPath(path);
+  }
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    error = "could not open " + path;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    error = "could not read " + path;
+    return false;
+  }
+
+  // An empty file cannot be mapped, but is still parsed, to report what
+  // is missing.
+  size_t size = st.st_size;
+  void *base = nullptr;
+  if (size > 0) {
+    base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED) {
+      close(fd);
+      error = "could not map " + path;
+      return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  const char *begin = base != nullptr ? (const char *) base : "";
+  const char *end = begin + size;
+  bool ok;
+  switch (format) {
+  case PointFormat::TSPLIB:
+    ok = parseTSPLIB(begin, end, points, error);
+    break;
+  case PointFormat::FLOAT32:
+    ok = parseBinary<float>(begin, end, points, error);
+    break;
+  case PointFormat::FLOAT64:
+    ok = parseBinary<double>(begin, end, points, error);
+    break;
+  default:
+    ok = parseText(begin, end, points, error);
+    break;
+  }
+
+  if (base != nullptr) {
+    munmap(base, size);
+  }
+  if (ok && points.empty()) {
+    error = "no points";
+    ok = false;
+  }
+  if (!ok) {
+    error = path + ": " + error;
+    points.clear();
+  }
+  return ok;
+}
@@ -0,0 +1,34 @@
+#ifndef POINTLOADER_HH
+#define POINTLOADER_HH
+
+#include <string>
+#include <vector>
+
+class Point;
+
+// The file formats loadPoints understands.
+//
+//   TEXT     the same numbers the program prompts for:  the number of
+//            points, then x, y and z for each point, separated by any
+//            whitespace.
+//   TSPLIB   a TSPLIB .tsp file with a NODE_COORD_SECTION, and an
+//            EDGE_WEIGHT_TYPE of EUC_2D, CEIL_2D or EUC_3D.  Points in a
+//            2D instance get a z of 0.
+//   FLOAT32  raw x, y, z triples of 4-byte floats, in the byte order of
+//   FLOAT64  the machine, or of 8-byte doubles, with no header.
+//
+// AUTO picks a format from the file name:  .tsp is TSPLIB, .f32 is
+// FLOAT32, .f64 is FLOAT64, and anything else is TEXT.
+enum class PointFormat {
+  AUTO, TEXT, TSPLIB, FLOAT32, FLOAT64
+};
+
+// Reads every point in the file at path into points, replacing what it
+// held.  The file is mapped into memory and parsed in place, so large
+// files load about as fast as they can be read.  Returns false and
+// describes the problem in error if the file cannot be read, is not in
+// the expected format, or holds no points.
+bool loadPoints(const std::string &path, PointFormat format,
+                std::vector<Point> &points, std::string &error);
+
+#endif // POINTLOADER_HH
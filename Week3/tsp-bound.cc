@@ -0,0 +1,205 @@
+#include "tsp-bound.hh"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+/* This file computes the Held-Karp lower bound. A 1-tree is a spanning tree
+ * of points 1 to n-1, plus the two shortest edges from point 0. Every tour
+ * is a 1-tree in which each point has exactly two edges, so the minimum
+ * 1-tree is no longer than the shortest tour.
+ *
+ * Adding a penalty p(i) to every edge at point i adds 2 * p(i) to every
+ * tour, so the minimum 1-tree under the penalized distances, less twice the
+ * sum of the penalties, is also a lower bound. Subgradient optimization
+ * searches for the penalties that make that bound largest, by raising the
+ * penalties of points with too many edges in the minimum 1-tree and
+ * lowering those of points with only one.
+ */
+
+/* At most this many minimum 1-trees are computed, each taking O(n^2)
+ * time. For large n, fewer are, so that all of them look at no more than
+ * MAX_BOUND_WORK pairs of points, but never fewer than
+ * MIN_BOUND_ITERATIONS. */
+const int MAX_BOUND_ITERATIONS = 1000;
+const int MIN_BOUND_ITERATIONS = 10;
+const long long MAX_BOUND_WORK = 1000000000;
+
+/* This function finds the minimum 1-tree under the penalized distances
+ * d(i, j) + penalty[i] + penalty[j], using Prim's algorithm for the
+ * spanning tree. It returns its penalized length, and stores the number of
+ * edges at each point in degree.
+ */
+static double minimumOneTree(const DistanceMatrix &dist,
+    const vector<double> &penalty, vector<int> &degree)
+{
+    int n = dist.size();
+    vector<double> key(n, 1e300);
+    vector<int> parent(n, -1);
+    vector<bool> inTree(n, false);
+    degree.assign(n, 0);
+
+    double length = 0;
+    int added = 1;
+    inTree[added] = true;
+    for (int step = 2; step < n; step++)
+    {
+        const double *from = dist.row(added);
+        int next = -1;
+        for (int j = 1; j < n; j++)
+        {
+            if (inTree[j])
+            {
+                continue;
+            }
+            double d = from[j] + penalty[added] + penalty[j];
+            if (d < key[j])
+            {
+                key[j] = d;
+                parent[j] = added;
+            }
+            if (next == -1 || key[j] < key[next])
+            {
+                next = j;
+            }
+        }
+
+        length += key[next];
+        inTree[next] = true;
+        degree[next]++;
+        degree[parent[next]]++;
+        added = next;
+    }
+
+    /* Then the two shortest edges from point 0 are added. */
+    const double *fromStart = dist.row(0);
+    int a = -1;
+    int b = -1;
+    for (int j = 1; j < n; j++)
+    {
+        double d = fromStart[j] + penalty[j];
+        if (a == -1 || d < fromStart[a] + penalty[a])
+        {
+            b = a;
+            a = j;
+        }
+        else if (b == -1 || d < fromStart[b] + penalty[b])
+        {
+            b = j;
+        }
+    }
+    length += fromStart[a] + fromStart[b] + 2 * penalty[0] + penalty[a] +
+        penalty[b];
+    degree[0] = 2;
+    degree[a]++;
+    degree[b]++;
+    return length;
+}
+
+/* This function returns the length of the tour that always goes on to the
+ * nearest point not yet visited. It gives the subgradient steps a scale. */
+static double nearestNeighbourLength(const DistanceMatrix &dist)
+{
+    int n = dist.size();
+    vector<bool> visited(n, false);
+    visited[0] = true;
+    int cur = 0;
+    double length = 0;
+    for (int step = 1; step < n; step++)
+    {
+        int next = -1;
+        for (int j = 0; j < n; j++)
+        {
+            if (!visited[j] && (next == -1 ||
+                dist.get(cur, j) < dist.get(cur, next)))
+            {
+                next = j;
+            }
+        }
+        length += dist.get(cur, next);
+        visited[next] = true;
+        cur = next;
+    }
+    return length + dist.get(cur, 0);
+}
+
+/* This function computes the bound. Each step moves the penalties along
+ * the degrees' excess over two, by an amount that shrinks as the bound
+ * approaches a known tour's length. The step is halved whenever the bound
+ * stops improving, and the best bound seen is returned.
+ */
+double heldKarpLowerBound(const DistanceMatrix &dist)
+{
+    int n = dist.size();
+    if (n < 2)
+    {
+        return 0;
+    }
+    if (n <= 3)
+    {
+        /* There is only one tour. */
+        return n == 2 ? 2 * dist.get(0, 1) :
+            dist.get(0, 1) + dist.get(1, 2) + dist.get(2, 0);
+    }
+
+    double upperBound = nearestNeighbourLength(dist);
+    vector<double> penalty(n, 0);
+    vector<int> degree;
+    double bestBound = 0;
+    double step = 2;
+    int patience = min(n / 2 + 5, 50);
+    int stale = 0;
+    long long iterations = MAX_BOUND_WORK / ((long long) n * n);
+    iterations = min(max(iterations, (long long) MIN_BOUND_ITERATIONS),
+        (long long) MAX_BOUND_ITERATIONS);
+
+    for (int iter = 0; iter < iterations && step > 1e-4; iter++)
+    {
+        double bound = minimumOneTree(dist, penalty, degree);
+        int norm = 0;
+        for (int i = 0; i < n; i++)
+        {
+            bound -= 2 * penalty[i];
+            norm += (degree[i] - 2) * (degree[i] - 2);
+        }
+
+        if (bound > bestBound)
+        {
+            bestBound = bound;
+            stale = 0;
+        }
+        else if (++stale >= patience)
+        {
+            step /= 2;
+            stale = 0;
+        }
+
+        /* If every point has two edges, the 1-tree is the shortest tour. */
+        if (norm == 0)
+        {
+            break;
+        }
+
+        double t = step * max(upperBound - bound, 0.0) / norm;
+        if (t == 0)
+        {
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            penalty[i] += t * (degree[i] - 2);
+        }
+    }
+
+    return bestBound;
+}
+
+/* This function works out the gap as a percentage of the lower bound. */
+double optimalityGap(double length, double lowerBound)
+{
+    if (lowerBound <= 0)
+    {
+        return 0;
+    }
+    return max(length - lowerBound, 0.0) / lowerBound * 100;
+}
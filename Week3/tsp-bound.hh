@@ -0,0 +1,20 @@
+#include "DistanceMatrix.hh"
+
+/* This is the header file for the lower bound on the length of a tour. A
+ * tour found by the genetic algorithm can be compared with the bound to
+ * see how far from the shortest possible tour it might be.
+ */
+
+
+/* This returns the Held-Karp lower bound on the length of the shortest
+ * tour through the points in dist: no tour can be shorter than it. It is
+ * usually within a percent or two of the shortest tour, though its running
+ * time is capped, so with thousands of points it is looser. It needs dist
+ * to have a table.
+ */
+double heldKarpLowerBound(const DistanceMatrix &dist);
+
+/* This returns how much longer than the shortest tour a tour of the given
+ * length can be, as a percentage, given a lower bound on the shortest.
+ */
+double optimalityGap(double length, double lowerBound);
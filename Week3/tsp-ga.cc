@@ -42,21 +42,46 @@ vector<int> TSPGenome::getOrder() const
     return order;
 }
 
-/* This function computes the circuitLength given a vector of points. */
-void TSPGenome::computeCircuitLength(const vector<Point> &points)
+/* This function computes the circuitLength given the distances between the
+ * points, so each edge is a single lookup in the matrix. */
+void TSPGenome::computeCircuitLength(const DistanceMatrix &dist)
 {
     double totalDistance = 0;
     for(int i = 0; i < order.size() - 1; i++) {
-        Point p1 = points[order[i]];
-        Point p2 = points[order[i+1]];
-        totalDistance += p1.distanceTo(p2);
+        totalDistance += dist.get(order[i], order[i+1]);
     }
 
-    totalDistance += points[order[order.size() - 1]].distanceTo(
-        points[order[0]]);
+    totalDistance += dist.get(order[order.size() - 1], order[0]);
     circuitLength = totalDistance;
 }
 
+/* This function computes the circuitLengths of a whole population at once.
+ * The distance matrix works through several genomes together, which is
+ * much faster than one genome at a time, and gives exactly the same
+ * lengths. */
+void TSPGenome::computeCircuitLengths(vector<TSPGenome> &genomes,
+    const DistanceMatrix &dist)
+{
+    if (genomes.empty())
+    {
+        return;
+    }
+
+    vector<const int *> circuits;
+    for (size_t i = 0; i < genomes.size(); i++)
+    {
+        circuits.push_back(genomes[i].order.data());
+    }
+    vector<double> lengths(genomes.size());
+    dist.circuitLengths(circuits.data(), genomes.size(),
+        genomes[0].order.size(), lengths.data());
+
+    for (size_t i = 0; i < genomes.size(); i++)
+    {
+        genomes[i].circuitLength = lengths[i];
+    }
+}
+
 /* This function just returns the circuitLength for that object */
 double TSPGenome::getCircuitLength() const
 {
@@ -118,15 +143,18 @@ bool isShorterPath(const TSPGenome &g1, const TSPGenome &g2)
 }
 
 /* This function finds a short path using the TSPGenomes.
- * It takes in a vector indicating the poitns being looked at, a population
+ * It takes in the distances between the points being looked at, a population
  * size, the number of generations to run for, the number of genomes to 
- * keep each generation and the number of mutations. 
+ * keep each generation and the number of mutations. If a path no longer
+ * than stopLength is found, it stops there, before running all the
+ * generations; a negative stopLength means there is no such target.
  */
 
-TSPGenome findAShortPath(const vector<Point> &points, int populationSize, 
-    int numGenerations, int keepPopulation, int numMutations)
+TSPGenome findAShortPath(const DistanceMatrix &dist, int populationSize,
+    int numGenerations, int keepPopulation, int numMutations,
+    double stopLength)
 {
-    int genomeSize = points.size();
+    int genomeSize = dist.size();
     int i = 0;
     vector<TSPGenome> population;
 
@@ -142,10 +170,8 @@ TSPGenome findAShortPath(const vector<Point> &points, int populationSize,
     int y = 0;
     while(y < numGenerations)
     {
-        for(int x = 0; x < populationSize; x++)
-        {
-            population[x].computeCircuitLength(points);
-        }
+        TSPGenome::computeCircuitLengths(population, dist);
+
         /* The current population vector is sorted using the isShorterPath
          * comparison function.
          */
@@ -160,6 +186,16 @@ TSPGenome findAShortPath(const vector<Point> &points, int populationSize,
                 population[0].getCircuitLength() << endl;
         }
 
+        /* The search stops once the best path is short enough. */
+        if (!(stopLength < 0 ||
+              population[0].getCircuitLength() > stopLength))
+        {
+            cout << "Generation " << y << ": shortest path is " << 
+                population[0].getCircuitLength() << ", short enough to "
+                "stop" << endl;
+            break;
+        }
+
         /* This replaces the less fit genomes in the population (genomes that
          * are not withing the keepPopulation limit.
          */
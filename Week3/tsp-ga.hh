@@ -1,5 +1,6 @@
 #include <vector>
 #include "Point.hh"
+#include "DistanceMatrix.hh"
 using namespace std;
 
 /* This is the header fille for the traveling salesman, genetic algorithm
@@ -38,9 +39,15 @@ class TSPGenome
         /* These are the mutator functions, which change the value of order
          * and circuitLength respectively.
          */
-        void computeCircuitLength(const vector<Point> &points);
+        void computeCircuitLength(const DistanceMatrix &dist);
         void mutate();
 
+        /* This computes the circuitLength of every genome in a population
+         * in one batch.
+         */
+        static void computeCircuitLengths(vector<TSPGenome> &genomes,
+            const DistanceMatrix &dist);
+
 };
 
 
@@ -48,5 +55,6 @@ TSPGenome* crosslink(const TSPGenome &g1, const TSPGenome &g2);
 
 bool isShorterPath(const TSPGenome &g1, const TSPGenome &g2);
 
-TSPGenome findAShortPath(const vector<Point> &points, int populationSize, 
-    int numGenerations, int keepPopulation, int numMutations);
+TSPGenome findAShortPath(const DistanceMatrix &dist, int populationSize,
+    int numGenerations, int keepPopulation, int numMutations,
+    double stopLength = -1);
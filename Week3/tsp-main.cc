@@ -1,4 +1,6 @@
 #include "tsp-ga.hh"
+#include "PointLoader.hh"
+#include "tsp-bound.hh"
 #include <stdlib.h>
 #include <algorithm>
 #include <iostream>
@@ -15,14 +17,15 @@ void printUsage(char *name)
 {
     cerr << "Usage: " << name << "POPULATION [positive int] "
         "GENERATION [positive int] KEEP [floating-point 0-1] "
-        "MUTATE [positive floating-point]" << endl;
+        "MUTATE [positive floating-point] [POINTS FILE "
+        "[TARGET GAP [percent]]]" << endl;
 }
 
 /* This is the main function of the program */
 int main(int argc, char **argv)
 {
     /* First, the command line arguments are parsed and checked */
-    if(argc != 5)
+    if(argc < 5 || argc > 7)
     {
         printUsage(argv[0]);
     }
@@ -41,9 +44,11 @@ int main(int argc, char **argv)
 
     int keepPopulation = int(atof(argv[3]) * popSize);
     int numMutations = int(atof(argv[4]) * popSize);
+    double targetGap = argc == 7 ? atof(argv[6]) : -1;
 
     /* The number of points is found and a points vector is generated
-     * using user input.
+     * using user input, or loaded from the points file without any prompts
+     * if one is given.
      */
     int numPoints;
     double coord1; 
@@ -52,26 +57,65 @@ int main(int argc, char **argv)
     vector<Point> points;
     vector<int> bestOrder;
 
-    cout  << "How many points? ";
-    cin >> numPoints;
+    if(argc >= 6)
+    {
+        string error;
+        if(!loadPoints(argv[5], PointFormat::AUTO, points, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        numPoints = points.size();
+    }
+    else
+    {
+        cout  << "How many points? ";
+        cin >> numPoints;
 
-    for(int i = 0; i < numPoints; i++) {
-        cout << "Point " << i << ": ";
-        cin >> coord1 >> coord2 >> coord3;
-        cout << "" << endl;
-        Point p = Point(coord1, coord2, coord3);
-        points.push_back(p);
+        for(int i = 0; i < numPoints; i++) {
+            cout << "Point " << i << ": ";
+            cin >> coord1 >> coord2 >> coord3;
+            cout << "" << endl;
+            Point p = Point(coord1, coord2, coord3);
+            points.push_back(p);
+        }
+    }
+
+    /* The distances between the points are worked out once, up front, for
+     * the bound and for every generation of the search.
+     *
+     * Given a target gap, the Held-Karp lower bound is worked out, which
+     * shows how far from the shortest possible path the result could be,
+     * and the search stops as soon as it is within that many percent of the
+     * bound. Without a distance table there are too many points to work the
+     * bound out.
+     */
+    DistanceMatrix dist(points);
+    double lowerBound = -1;
+    if(targetGap >= 0 && dist.hasTable())
+    {
+        lowerBound = heldKarpLowerBound(dist);
+    }
+    else if(targetGap >= 0)
+    {
+        cerr << "Too many points for a lower bound, so the target gap is "
+            "ignored" << endl;
+    }
+    double stopLength = -1;
+    if(lowerBound >= 0)
+    {
+        stopLength = lowerBound * (1 + targetGap / 100);
     }
 
     srand(time(nullptr));
     /* The findAShortPath function is then called and it's result is stored. */
-    TSPGenome bestGenome = findAShortPath(points, popSize, generations, 
-        keepPopulation, numMutations);
+    TSPGenome bestGenome = findAShortPath(dist, popSize, generations, 
+        keepPopulation, numMutations, stopLength);
     
     /* The results are then printed out */
 
     bestOrder = bestGenome.getOrder();
-    bestGenome.computeCircuitLength(points);
+    bestGenome.computeCircuitLength(dist);
     double circuitLength = bestGenome.getCircuitLength();
     
     cout << "Best Order: [";
@@ -79,6 +123,12 @@ int main(int argc, char **argv)
         cout << bestOrder[i] << " ";
     }
     cout << "]" << endl;
-    cout << "Shortest distance: " << circuitLength << endl;
+    cout << "Shortest distance: " << circuitLength;
+    if(lowerBound >= 0)
+    {
+        cout << " (at most " << optimalityGap(circuitLength, lowerBound) <<
+            "% above optimal)";
+    }
+    cout << endl;
 
 }
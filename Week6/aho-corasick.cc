@@ -0,0 +1,119 @@
+#include "aho-corasick.hh"
+
+#include <algorithm>
+#include <map>
+
+
+/* Builds the automaton.  The literals are first inserted into a trie; then a
+ * breadth-first walk computes each state's failure link and fills in its row
+ * of the transition table, borrowing the failure state's row for every byte
+ * class the trie has no edge for.
+ *
+ * The literals must not be empty.
+ */
+AhoCorasick::AhoCorasick(const vector<string> &literals) {
+    // Byte class 0 holds every byte that no literal uses.
+    bitset<256> used;
+    for (const string &lit : literals) {
+        assert(!lit.empty());
+        for (char c : lit)
+            used[(unsigned char) c] = true;
+    }
+
+    numClasses = 1;
+    for (int c = 0; c < 256; c++)
+        byteClass[c] = used[c] ? numClasses++ : 0;
+
+    // Build the trie.
+    vector<map<int, int>> children(1);
+    vector<vector<int>> ends(1);
+    for (int i = 0; i < (int) literals.size(); i++) {
+        int state = 0;
+        for (char c : literals[i]) {
+            int cls = byteClass[(unsigned char) c];
+            auto child = children[state].find(cls);
+            if (child == children[state].end()) {
+                int id = children.size();
+                children[state][cls] = id;
+                children.push_back(map<int, int>());
+                ends.push_back(vector<int>());
+                state = id;
+            }
+            else {
+                state = child->second;
+            }
+        }
+        ends[state].push_back(i);
+        lengths.push_back(literals[i].length());
+    }
+
+    int numStates = children.size();
+    trans.assign((size_t) numStates * numClasses, 0);
+    vector<int> fail(numStates, 0);
+    vector<vector<int>> out(numStates);
+
+    // Breadth-first order guarantees a state's failure state, which is
+    // shallower, is complete before the state itself is processed.
+    vector<int> queue;
+    queue.push_back(0);
+    for (int q = 0; q < (int) queue.size(); q++) {
+        int state = queue[q];
+
+        out[state] = ends[state];
+        if (state != 0) {
+            const vector<int> &inherited = out[fail[state]];
+            out[state].insert(out[state].end(), inherited.begin(),
+                              inherited.end());
+            sort(out[state].begin(), out[state].end());
+        }
+
+        for (int cls = 0; cls < numClasses; cls++) {
+            auto child = children[state].find(cls);
+            size_t index = (size_t) state * numClasses + cls;
+
+            if (child == children[state].end()) {
+                trans[index] = state == 0 ? 0 :
+                    trans[(size_t) fail[state] * numClasses + cls];
+            }
+            else {
+                int next = child->second;
+                fail[next] = state == 0 ? 0 :
+                    trans[(size_t) fail[state] * numClasses + cls];
+                trans[index] = next;
+                queue.push_back(next);
+            }
+        }
+    }
+
+    outStart.push_back(0);
+    for (int state = 0; state < numStates; state++) {
+        outputs.insert(outputs.end(), out[state].begin(), out[state].end());
+        outStart.push_back(outputs.size());
+    }
+}
+
+
+int AhoCorasick::getNumStates() const {
+    return outStart.size() - 1;
+}
+
+
+/* Appends every occurrence of every literal in s to hits, ordered by end
+ * index and then by pattern index.  Occurrences may overlap.
+ */
+void AhoCorasick::findAll(const string &s, vector<PatternHit> &hits) const {
+    int len = s.length();
+    uint32_t state = 0;
+
+    for (int i = 0; i < len; i++) {
+        int cls = byteClass[(unsigned char) s[i]];
+        state = trans[(size_t) state * numClasses + cls];
+
+        for (int o = outStart[state]; o < outStart[state + 1]; o++) {
+            PatternHit hit;
+            hit.pattern = outputs[o];
+            hit.range = Range(i + 1 - lengths[hit.pattern], i + 1);
+            hits.push_back(hit);
+        }
+    }
+}
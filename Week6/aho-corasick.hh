@@ -0,0 +1,50 @@
+#ifndef AHO_CORASICK_HH
+#define AHO_CORASICK_HH
+
+#include "regex.hh"
+
+#include <cstdint>
+
+
+/* One occurrence of a pattern from a set of patterns. */
+struct PatternHit {
+    int pattern;        // index of the pattern in its set
+    Range range;        // where it occurs
+};
+
+
+/* An Aho-Corasick automaton that finds every occurrence of a set of literal
+ * strings in one pass over the input.
+ *
+ * The failure links are resolved when the automaton is built, so the search
+ * is a plain DFA walk with one table lookup per input byte.  The table is
+ * dense, but its columns are byte classes rather than bytes:  all bytes that
+ * appear in no literal share one class, which keeps the table small when the
+ * literals use only a few distinct characters.
+ */
+class AhoCorasick {
+    // Maps each byte to its column in the transition table.
+    uint16_t byteClass[256];
+    int numClasses;
+
+    // numStates * numClasses entries; state 0 is the root.
+    vector<uint32_t> trans;
+
+    // The patterns that end at each state are
+    // outputs[outStart[s]] .. outputs[outStart[s + 1] - 1], sorted by
+    // pattern index.
+    vector<int> outStart;
+    vector<int> outputs;
+
+    vector<int> lengths;
+
+public:
+    AhoCorasick(const vector<string> &literals);
+
+    int getNumStates() const;
+
+    void findAll(const string &s, vector<PatternHit> &hits) const;
+};
+
+
+#endif // AHO_CORASICK_HH
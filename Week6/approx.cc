@@ -0,0 +1,132 @@
+#include "approx.hh"
+
+
+ApproxMatcher::ApproxMatcher(const vector<RegexOperator *> &regex,
+                             int maxErrors) {
+    assert(maxErrors >= 0);
+    this->maxErrors = maxErrors;
+    engine = nullptr;
+
+    vector<RegexStep> steps = flattenRegex(regex);
+    if (steps.size() > MAX_STEPS)
+        return;
+    for (const RegexStep &step : steps) {
+        if (step.minRepeat > 1 ||
+            (step.maxRepeat != 1 && step.maxRepeat != -1))
+            return;
+    }
+
+    engine = new ShiftAndEngine<1>(steps);
+}
+
+ApproxMatcher::~ApproxMatcher() {
+    delete engine;
+}
+
+
+bool ApproxMatcher::ok() const {
+    return engine != nullptr;
+}
+
+
+/* Sets up the rows before any input is read.  With no input, the only edits
+ * possible are missing operators, so row i holds the operators that can be
+ * skipped over with i deletions from the start of the regex.
+ */
+void ApproxMatcher::initialRows(vector<Mask> &rows) const {
+    rows.resize(maxErrors + 1);
+    rows[0].clear();
+    for (int i = 1; i <= maxErrors; i++)
+        rows[i] = rows[i - 1] | engine->ready(rows[i - 1], true);
+}
+
+
+/* Advances the rows over input character c, which is preceded by consumed
+ * characters.  For row i, the new state is the union of:
+ *
+ *   - row i, matching c normally;
+ *   - row i - 1, with some ready operator consuming c anyway (a
+ *     substitution);
+ *   - row i - 1 unchanged, with c treated as an extra character (an
+ *     insertion);
+ *   - the new row i - 1, with the next ready operators skipped (a
+ *     deletion).
+ *
+ * When anchored, the regex may only begin at index 0, or later if every
+ * character before that was an insertion, which costs one error each.
+ */
+void ApproxMatcher::advance(vector<Mask> &rows, unsigned char c, int consumed,
+                            bool anchored) const {
+    const Mask &accepts = engine->acceptsChar(c);
+
+    Mask below = rows[0];
+    rows[0] = engine->ready(rows[0], !anchored || consumed == 0) & accepts;
+
+    for (int i = 1; i <= maxErrors; i++) {
+        Mask old = rows[i];
+        rows[i] = (engine->ready(old, !anchored || consumed <= i) & accepts) |
+            engine->ready(below, !anchored || consumed <= i - 1) |
+            below |
+            engine->ready(rows[i - 1], !anchored || consumed + 1 <= i - 1);
+        below = old;
+    }
+}
+
+
+/* Returns the fewest errors with which the regex can end here, or -1.  A
+ * regex that matches the empty string can also end after consumed
+ * insertions.
+ */
+int ApproxMatcher::fewestErrors(const vector<Mask> &rows, int consumed,
+                                bool anchored) const {
+    for (int i = 0; i <= maxErrors; i++) {
+        if (engine->isFinal(rows[i]))
+            return i;
+        if (engine->matchesEmptyString() && (!anchored || consumed <= i))
+            return i;
+    }
+    return -1;
+}
+
+
+/* Returns the index just past the earliest-ending approximate match in s,
+ * or -1 if there is none.  The number of errors in the best match ending
+ * there is stored in errors.
+ */
+int ApproxMatcher::findEnd(const string &s, int &errors) const {
+    assert(ok());
+
+    vector<Mask> rows;
+    initialRows(rows);
+
+    errors = fewestErrors(rows, 0, false);
+    if (errors != -1)
+        return 0;
+
+    int len = s.length();
+    for (int i = 0; i < len; i++) {
+        advance(rows, s[i], i, false);
+        errors = fewestErrors(rows, i + 1, false);
+        if (errors != -1)
+            return i + 1;
+    }
+
+    return -1;
+}
+
+
+/* Returns the fewest errors with which the regex matches all of s, or -1 if
+ * it needs more than the maximum.
+ */
+int ApproxMatcher::distance(const string &s) const {
+    assert(ok());
+
+    vector<Mask> rows;
+    initialRows(rows);
+
+    int len = s.length();
+    for (int i = 0; i < len; i++)
+        advance(rows, s[i], i, true);
+
+    return fewestErrors(rows, len, true);
+}
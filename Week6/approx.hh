@@ -0,0 +1,48 @@
+#ifndef APPROX_HH
+#define APPROX_HH
+
+#include "shift-and.hh"
+
+
+/* Finds approximate matches of a regex:  matches with at most maxErrors
+ * edits, where an edit is an extra input character, a missing operator, or
+ * an operator matched against the wrong character.
+ *
+ * This extends the Shift-And engine with one state word per number of
+ * errors (Wu and Manber's method).  Row i holds the operators that can have
+ * consumed the last character using at most i edits, and each input byte
+ * updates every row with a few word operations from its own old value and
+ * the row below, so the cost is proportional to maxErrors + 1 rather than to
+ * the number of ways the pattern could be misspelled.
+ */
+class ApproxMatcher {
+    typedef ShiftAndEngine<1>::Mask Mask;
+
+    ShiftAndEngine<1> *engine;
+    int maxErrors;
+
+    // Not copyable, since the object owns its engine.
+    ApproxMatcher(const ApproxMatcher &);
+    ApproxMatcher & operator=(const ApproxMatcher &);
+
+    void initialRows(vector<Mask> &rows) const;
+    void advance(vector<Mask> &rows, unsigned char c, int consumed,
+                 bool anchored) const;
+    int fewestErrors(const vector<Mask> &rows, int consumed,
+                     bool anchored) const;
+
+public:
+    static const int MAX_STEPS = 64;
+
+    ApproxMatcher(const vector<RegexOperator *> &regex, int maxErrors);
+    ~ApproxMatcher();
+
+    // False if the regex is too long, or uses unsupported repeat counts.
+    bool ok() const;
+
+    int findEnd(const string &s, int &errors) const;
+    int distance(const string &s) const;
+};
+
+
+#endif // APPROX_HH
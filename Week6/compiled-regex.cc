@@ -0,0 +1,292 @@
+#include "compiled-regex.hh"
+#include "engine.hh"
+
+#include <thread>
+
+
+/* Parses the pattern, works out which engines are applicable, and applies
+ * the complexity policy.
+ */
+CompiledRegex::CompiledRegex(const string &pattern, int flags,
+                             const ComplexityPolicy &policy) {
+    regex = parseRegex(pattern, flags);
+    literal = nullptr;
+    dfa = nullptr;
+    dfaTried = false;
+
+    for (int e = 0; e < NUM_ENGINES; e++)
+        calls[e] = 0;
+
+    string text;
+    if (getLiteral(regex, text) && !text.empty())
+        literal = new LiteralSearcher(text);
+
+    shiftAnd = new ShiftAnd(regex);
+    if (!shiftAnd->ok()) {
+        delete shiftAnd;
+        shiftAnd = nullptr;
+    }
+
+    hasRepeats = false;
+    for (RegexOperator *op : regex) {
+        if (op->getMinRepeat() != 1 || op->getMaxRepeat() != 1)
+            hasRepeats = true;
+    }
+
+    complexity = analyzeRegex(regex);
+    linearOnly = false;
+    rejected = false;
+    if (complexity.degree > policy.maxDegree) {
+        if (policy.action == ComplexityAction::REJECT) {
+            rejected = true;
+        }
+        else if (policy.action == ComplexityAction::FORCE_LINEAR) {
+            linearOnly = true;
+
+            // Without a linear engine to fall back on, the pattern cannot
+            // be searched at all.
+            if (literal == nullptr && shiftAnd == nullptr &&
+                getDFA() == nullptr)
+                rejected = true;
+        }
+    }
+}
+
+CompiledRegex::~CompiledRegex() {
+    delete literal;
+    delete shiftAnd;
+    delete dfa;
+    clearRegex(regex);
+}
+
+
+/* Returns the DFA, building it if this is the first request, or null if the
+ * pattern needs too many states.
+ */
+const DFA * CompiledRegex::getDFA() {
+    if (!dfaTried) {
+        dfaTried = true;
+        dfa = new DFA(regex);
+        if (!dfa->ok()) {
+            delete dfa;
+            dfa = nullptr;
+        }
+    }
+    return dfa;
+}
+
+
+bool CompiledRegex::ok() const {
+    return !rejected;
+}
+
+const RegexComplexity & CompiledRegex::getComplexity() const {
+    return complexity;
+}
+
+
+/* Returns the engine that a search of an input of the given length will
+ * use.  This may build the DFA.
+ */
+CompiledRegex::Engine CompiledRegex::chooseEngine(size_t inputLength) {
+    assert(ok());
+
+    if (literal != nullptr)
+        return Engine::LITERAL;
+
+    if (!hasRepeats && !linearOnly && inputLength < SHORT_INPUT_LENGTH)
+        return Engine::BACKTRACK;
+
+    if (shiftAnd != nullptr && inputLength < SHORT_INPUT_LENGTH)
+        return Engine::SHIFT_AND;
+
+    if (getDFA() == nullptr)
+        return shiftAnd != nullptr ? Engine::SHIFT_AND : Engine::BACKTRACK;
+
+    if (inputLength >= 2 * (size_t) DFA::MIN_SEGMENT_LENGTH &&
+        thread::hardware_concurrency() > 1)
+        return Engine::PARALLEL_DFA;
+
+    return Engine::DFA;
+}
+
+
+/* Returns the engine for a walk through a whole input with many searches,
+ * which is counted as one call.
+ */
+CompiledRegex::Engine CompiledRegex::chooseScanEngine(size_t inputLength) {
+    Engine e = chooseEngine(inputLength);
+    if (e == Engine::PARALLEL_DFA)
+        e = Engine::DFA;
+    calls[(int) e]++;
+    return e;
+}
+
+
+/* Finds the leftmost, longest match that starts at or after index from.
+ * The engine is chosen by the length of the input that is left to search.
+ */
+Range CompiledRegex::find(const string &s, int from) {
+    assert(from >= 0 && from <= (int) s.length());
+
+    Engine e = chooseEngine(s.length() - from);
+    calls[(int) e]++;
+    return findWith(e, s, from);
+}
+
+
+/* Finds the leftmost, longest match at or after from with the given engine. */
+Range CompiledRegex::findWith(Engine e, const string &s, int from) {
+    switch (e) {
+    case Engine::LITERAL: {
+        int index = literal->find(s, from);
+        if (index == -1)
+            return Range(-1, -1);
+        return Range(index, index + literal->length());
+    }
+
+    case Engine::SHIFT_AND:
+        return shiftAnd->find(s, from);
+
+    case Engine::DFA:
+        return dfa->find(s, from);
+
+    case Engine::PARALLEL_DFA: {
+        BufferRange r = dfa->parallelFind(s.data() + from, s.length() - from,
+                                          0);
+        if (r.start == -1)
+            return Range(-1, -1);
+        return Range(from + r.start, from + r.end);
+    }
+
+    default: {
+        EngineStats stats;
+        for (int i = from; i < (int) s.length(); i++) {
+            Range r = findAtIndex(regex, s, i, stats);
+            if (r.start != -1)
+                return r;
+        }
+        return Range(-1, -1);
+    }
+    }
+}
+
+
+bool CompiledRegex::match(const string &s) {
+    Engine e = chooseEngine(s.length());
+
+    // A whole-string match never benefits from splitting the input.
+    if (e == Engine::PARALLEL_DFA)
+        e = Engine::DFA;
+    calls[(int) e]++;
+
+    switch (e) {
+    case Engine::LITERAL:
+        return (int) s.length() == literal->length() &&
+            literal->find(s) == 0;
+
+    case Engine::SHIFT_AND:
+        return shiftAnd->match(s);
+
+    case Engine::DFA:
+        return dfa->match(s);
+
+    default:
+        return ::match(regex, s);
+    }
+}
+
+
+/* Returns s with every match replaced.  In the replacement, $0 stands for
+ * the matched text and $$ for a single $; any other $ is copied as is, since
+ * these regexes have no capture groups.  The output is built in one buffer,
+ * reserved up front, and the input is only read once:  each search starts
+ * where the previous match ended.  After an empty match, one character is
+ * copied before searching again, so that the search always moves forward.
+ */
+string CompiledRegex::replaceAll(const string &s, const string &replacement) {
+    string out;
+    out.reserve(s.length() + replacement.length());
+
+    Engine e = chooseScanEngine(s.length());
+    int len = s.length();
+    int pos = 0;
+    while (pos < len) {
+        Range r = findWith(e, s, pos);
+        if (r.start == -1)
+            break;
+
+        out.append(s, pos, r.start - pos);
+        for (int i = 0; i < (int) replacement.length(); i++) {
+            char c = replacement[i];
+            if (c == '$' && i + 1 < (int) replacement.length()) {
+                if (replacement[i + 1] == '0') {
+                    out.append(s, r.start, r.end - r.start);
+                    i++;
+                    continue;
+                }
+                if (replacement[i + 1] == '$')
+                    i++;
+            }
+            out += c;
+        }
+
+        pos = r.end;
+        if (r.end == r.start)
+            out += s[pos++];
+    }
+
+    out.append(s, pos, len - pos);
+    return out;
+}
+
+
+/* Splits s at every non-empty match, and returns the ranges of the pieces
+ * between them, so that no text is copied.  There is always at least one
+ * piece, and pieces may be empty.
+ */
+vector<Range> CompiledRegex::split(const string &s) {
+    vector<Range> pieces;
+
+    Engine e = chooseScanEngine(s.length());
+    int len = s.length();
+    int pieceStart = 0;
+    int pos = 0;
+    while (pos < len) {
+        Range r = findWith(e, s, pos);
+        if (r.start == -1)
+            break;
+
+        if (r.end == r.start) {
+            pos = r.end + 1;
+            continue;
+        }
+
+        pieces.push_back(Range(pieceStart, r.start));
+        pieceStart = pos = r.end;
+    }
+
+    pieces.push_back(Range(pieceStart, len));
+    return pieces;
+}
+
+
+long CompiledRegex::getCalls(Engine e) const {
+    return calls[(int) e];
+}
+
+const char * CompiledRegex::engineName(Engine e) {
+    switch (e) {
+    case Engine::BACKTRACK:
+        return "backtrack";
+    case Engine::LITERAL:
+        return "literal";
+    case Engine::SHIFT_AND:
+        return "shift-and";
+    case Engine::DFA:
+        return "dfa";
+    case Engine::PARALLEL_DFA:
+        return "parallel-dfa";
+    }
+    return "unknown";
+}
@@ -0,0 +1,95 @@
+#ifndef COMPILED_REGEX_HH
+#define COMPILED_REGEX_HH
+
+#include "dfa.hh"
+#include "literal.hh"
+#include "regex-analysis.hh"
+#include "shift-and.hh"
+
+
+/* A regex compiled once and then searched many times, which picks the
+ * cheapest engine for each call.  Every engine gives the same results as the
+ * backtracking engine; only the cost differs.
+ *
+ * The routing rules are:
+ *
+ *   - A plain literal is searched with a LiteralSearcher.
+ *   - A pattern with no repeats, on a short input, goes to the backtracker:
+ *     it never actually backtracks, and the DFA need not be built.
+ *   - A pattern with repeats, on a short input, goes to the bit-parallel
+ *     Shift-And engine, which needs no automaton construction.
+ *   - Inputs long enough to split across cores use the parallel DFA search.
+ *   - Everything else uses the DFA, unless it would need too many states, in
+ *     which case Shift-And is used, or the backtracker if the pattern is too
+ *     long for Shift-And.
+ *
+ * The DFA is built the first time it is needed.  The number of calls routed
+ * to each engine is counted, so the routing can be audited.
+ *
+ * replaceAll() and split() walk the input once from left to right, each
+ * search starting where the last match ended.  They choose one engine for
+ * the whole walk, and never the parallel DFA:  each search stops at the next
+ * match, so splitting the rest of the input across threads for every match
+ * would rescan it over and over.
+ *
+ * Every pattern is analyzed when it is compiled, and a ComplexityPolicy
+ * decides what happens to patterns the backtracker would handle badly:
+ * they can be rejected (ok() is then false), or kept away from the
+ * backtracker entirely.
+ */
+class CompiledRegex {
+public:
+    enum class Engine {
+        BACKTRACK, LITERAL, SHIFT_AND, DFA, PARALLEL_DFA
+    };
+    static const int NUM_ENGINES = 5;
+
+    // Inputs shorter than this count as short.
+    static const int SHORT_INPUT_LENGTH = 64;
+
+private:
+    vector<RegexOperator *> regex;
+    bool hasRepeats;
+
+    LiteralSearcher *literal;   // non-null for literal patterns
+    ShiftAnd *shiftAnd;         // non-null for patterns it can handle
+    DFA *dfa;                   // built on first use
+    bool dfaTried;
+
+    RegexComplexity complexity;
+    bool linearOnly;            // never use the backtracker
+    bool rejected;
+
+    long calls[NUM_ENGINES];
+
+    // Not copyable, since the object owns its operators and engines.
+    CompiledRegex(const CompiledRegex &);
+    CompiledRegex & operator=(const CompiledRegex &);
+
+    const DFA * getDFA();
+    Engine chooseScanEngine(size_t inputLength);
+    Range findWith(Engine e, const string &s, int from);
+
+public:
+    CompiledRegex(const string &pattern, int flags = 0,
+                  const ComplexityPolicy &policy = ComplexityPolicy());
+    ~CompiledRegex();
+
+    // False if the policy rejected the pattern.
+    bool ok() const;
+    const RegexComplexity & getComplexity() const;
+
+    Engine chooseEngine(size_t inputLength);
+
+    Range find(const string &s, int from = 0);
+    bool match(const string &s);
+
+    string replaceAll(const string &s, const string &replacement);
+    vector<Range> split(const string &s);
+
+    long getCalls(Engine e) const;
+    static const char * engineName(Engine e);
+};
+
+
+#endif // COMPILED_REGEX_HH
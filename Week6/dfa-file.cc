@@ -0,0 +1,271 @@
+#include "dfa-file.hh"
+
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Rounds offset up to the next multiple of 8, so every table in the file
+ * starts suitably aligned.
+ */
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~((uint64_t) 7);
+}
+
+
+bool writeDFAFile(const string &path, const vector<string> &patterns,
+                  string &error) {
+    vector<DFA *> dfas;
+    vector<DFAFileEntry> entries;
+
+    uint64_t offset = sizeof(DFAFileHeader) +
+        patterns.size() * sizeof(DFAFileEntry);
+
+    bool ok = true;
+    for (int i = 0; i < (int) patterns.size(); i++) {
+        vector<RegexOperator *> regex = parseRegex(patterns[i]);
+        DFA *dfa = new DFA(regex);
+        clearRegex(regex);
+        dfas.push_back(dfa);
+
+        if (!dfa->ok()) {
+            error = "pattern " + to_string(i) + " (\"" + patterns[i] +
+                "\") needs too many DFA states";
+            ok = false;
+            break;
+        }
+
+        DFAFileEntry entry;
+        entry.patternOffset = offset;
+        entry.patternLength = patterns[i].length();
+        offset = align8(offset + entry.patternLength);
+
+        entry.numStates = dfa->getNumStates();
+        entry.numClasses = dfa->getNumClasses();
+        entry.anchoredStart = dfa->getAnchoredStart();
+        entry.unanchoredStart = dfa->getUnanchoredStart();
+        entry.reserved = 0;
+
+        entry.classOffset = offset;
+        offset = align8(offset + 256);
+
+        entry.transOffset = offset;
+        offset = align8(offset + (uint64_t) entry.numStates *
+            entry.numClasses * sizeof(uint32_t));
+
+        entry.acceptOffset = offset;
+        offset = align8(offset + entry.numStates);
+
+        entries.push_back(entry);
+    }
+
+    if (ok) {
+        DFAFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, DFA_FILE_MAGIC, sizeof(header.magic));
+        header.version = DFA_FILE_VERSION;
+        header.byteOrder = DFA_FILE_BYTE_ORDER;
+        header.fileSize = offset;
+        header.numPatterns = patterns.size();
+
+        // Assemble the image in memory so that padding is zero-filled and
+        // the file is written in one go.
+        vector<char> image(offset, 0);
+        memcpy(image.data(), &header, sizeof(header));
+        memcpy(image.data() + sizeof(header), entries.data(),
+               entries.size() * sizeof(DFAFileEntry));
+
+        for (int i = 0; i < (int) entries.size(); i++) {
+            const DFAFileEntry &e = entries[i];
+            memcpy(image.data() + e.patternOffset, patterns[i].data(),
+                   e.patternLength);
+            memcpy(image.data() + e.classOffset, dfas[i]->getByteClasses(),
+                   256);
+            memcpy(image.data() + e.transOffset, dfas[i]->getTransitions(),
+                   (size_t) e.numStates * e.numClasses * sizeof(uint32_t));
+            memcpy(image.data() + e.acceptOffset, dfas[i]->getAccepting(),
+                   e.numStates);
+        }
+
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(image.data(), image.size());
+        out.close();
+        if (!out) {
+            error = "could not write " + path;
+            ok = false;
+        }
+    }
+
+    for (DFA *dfa : dfas)
+        delete dfa;
+
+    return ok;
+}
+
+
+/* Returns true if the length bytes at offset lie inside a file of the given
+ * size, without overflowing on hostile offsets.
+ */
+static bool inFile(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+
+DFAFile::DFAFile() {
+    base = nullptr;
+    size = 0;
+}
+
+DFAFile::~DFAFile() {
+    close();
+}
+
+
+/* Maps the file at path and checks that it is a well-formed DFA file.  No
+ * pattern is parsed; the DFAs are views over the mapped tables.
+ */
+bool DFAFile::open(const string &path, string &error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        error = "could not open " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(DFAFileHeader)) {
+        ::close(fd);
+        error = path + " is too small to be a DFA file";
+        return false;
+    }
+
+    size = st.st_size;
+    base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        size = 0;
+        error = "could not map " + path;
+        return false;
+    }
+
+    if (!validate(error)) {
+        error = path + ": " + error;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+/* Checks the header, and that every table lies inside the file and every
+ * byte class and transition is in range, then builds the DFA views.  After this
+ * succeeds, matching can never read outside the mapping.
+ */
+bool DFAFile::validate(string &error) {
+    const char *bytes = (const char *) base;
+    const DFAFileHeader *header = (const DFAFileHeader *) bytes;
+
+    if (memcmp(header->magic, DFA_FILE_MAGIC, sizeof(header->magic)) != 0) {
+        error = "not a DFA file";
+        return false;
+    }
+    if (header->byteOrder != DFA_FILE_BYTE_ORDER) {
+        error = "written on a machine with a different byte order";
+        return false;
+    }
+    if (header->version != DFA_FILE_VERSION) {
+        error = "unsupported version " + to_string(header->version);
+        return false;
+    }
+    if (header->fileSize != size) {
+        error = "truncated or padded file";
+        return false;
+    }
+
+    uint64_t entriesEnd = sizeof(DFAFileHeader) +
+        (uint64_t) header->numPatterns * sizeof(DFAFileEntry);
+    if (entriesEnd > size) {
+        error = "pattern table runs past the end of the file";
+        return false;
+    }
+
+    const DFAFileEntry *entries =
+        (const DFAFileEntry *) (bytes + sizeof(DFAFileHeader));
+
+    for (uint32_t i = 0; i < header->numPatterns; i++) {
+        const DFAFileEntry &e = entries[i];
+        uint64_t numEntries = (uint64_t) e.numStates * e.numClasses;
+        uint64_t transSize = numEntries * sizeof(uint32_t);
+
+        if (e.numStates == 0 || e.numClasses == 0 || e.numClasses > 256 ||
+            e.anchoredStart >= e.numStates ||
+            e.unanchoredStart >= e.numStates ||
+            !inFile(e.patternOffset, e.patternLength, size) ||
+            !inFile(e.classOffset, 256, size) ||
+            e.transOffset % sizeof(uint32_t) != 0 ||
+            !inFile(e.transOffset, transSize, size) ||
+            !inFile(e.acceptOffset, e.numStates, size)) {
+            error = "pattern " + to_string(i) + " is malformed";
+            return false;
+        }
+
+        const uint8_t *classes = (const uint8_t *) (bytes + e.classOffset);
+        for (int c = 0; c < 256; c++) {
+            if (classes[c] >= e.numClasses) {
+                error = "pattern " + to_string(i) +
+                    " maps a byte to a nonexistent class";
+                return false;
+            }
+        }
+
+        const uint32_t *trans = (const uint32_t *) (bytes + e.transOffset);
+        for (uint64_t t = 0; t < numEntries; t++) {
+            if (trans[t] >= e.numStates) {
+                error = "pattern " + to_string(i) +
+                    " has a transition to a nonexistent state";
+                return false;
+            }
+        }
+
+        patterns.push_back(string(bytes + e.patternOffset, e.patternLength));
+        dfas.push_back(new DFA(e.numStates, e.numClasses, e.anchoredStart,
+            e.unanchoredStart, classes, trans,
+            (const uint8_t *) (bytes + e.acceptOffset)));
+    }
+
+    return true;
+}
+
+
+void DFAFile::close() {
+    for (DFA *dfa : dfas)
+        delete dfa;
+    dfas.clear();
+    patterns.clear();
+
+    if (base != nullptr)
+        munmap(base, size);
+    base = nullptr;
+    size = 0;
+}
+
+
+int DFAFile::numPatterns() const {
+    return dfas.size();
+}
+
+const string & DFAFile::getPattern(int i) const {
+    return patterns[i];
+}
+
+const DFA & DFAFile::getDFA(int i) const {
+    return *dfas[i];
+}
@@ -0,0 +1,93 @@
+#ifndef DFA_FILE_HH
+#define DFA_FILE_HH
+
+#include "dfa.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* Precompiled DFA files hold the automata for a whole set of patterns, so a
+ * program can load them without parsing or running subset construction.
+ *
+ * The file is laid out so that it can be used directly from an mmap:  every
+ * reference inside it is a byte offset from the start of the file, every
+ * table is aligned for its element type, and integers are stored in the byte
+ * order of the machine that wrote the file (recorded in the header, so a
+ * mismatched file is rejected rather than misread).
+ *
+ *   DFAFileHeader
+ *   DFAFileEntry[numPatterns]
+ *   for each pattern:  the pattern text, the byte class map (uint8_t, 256
+ *                      entries), the transition table (uint32_t, numStates *
+ *                      numClasses entries) and the accept flags (uint8_t,
+ *                      numStates entries)
+ *
+ * Version 1 files, which predate byte classes, are no longer accepted.
+ */
+
+const char DFA_FILE_MAGIC[8] = { 'L', 'S', 'D', 'F', 'A', 0, 0, 0 };
+const uint32_t DFA_FILE_VERSION = 2;
+const uint32_t DFA_FILE_BYTE_ORDER = 0x01020304;
+
+struct DFAFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint32_t numPatterns;
+    uint32_t reserved;
+};
+
+struct DFAFileEntry {
+    uint64_t patternOffset;
+    uint64_t classOffset;
+    uint64_t transOffset;
+    uint64_t acceptOffset;
+    uint32_t patternLength;
+    uint32_t numStates;
+    uint32_t numClasses;
+    uint32_t anchoredStart;
+    uint32_t unanchoredStart;
+    uint32_t reserved;
+};
+
+
+/* Compiles every pattern and writes the resulting DFA file to path.  Returns
+ * false and describes the problem in error if a pattern cannot be compiled
+ * or the file cannot be written.
+ */
+bool writeDFAFile(const string &path, const vector<string> &patterns,
+                  string &error);
+
+
+/* A read-only, memory-mapped DFA file.  The DFAs it hands out point straight
+ * into the mapping, so pages are shared with every other process that maps
+ * the same file.
+ */
+class DFAFile {
+    void *base;
+    size_t size;
+    vector<DFA *> dfas;
+    vector<string> patterns;
+
+    // The mapping and the DFAs that point into it are not copyable.
+    DFAFile(const DFAFile &);
+    DFAFile & operator=(const DFAFile &);
+
+    bool validate(string &error);
+
+public:
+    DFAFile();
+    ~DFAFile();
+
+    bool open(const string &path, string &error);
+    void close();
+
+    int numPatterns() const;
+    const string & getPattern(int i) const;
+    const DFA & getDFA(int i) const;
+};
+
+
+#endif // DFA_FILE_HH
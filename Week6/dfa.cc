@@ -0,0 +1,949 @@
+#include "dfa.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+
+/* Builds the DFA for the regex by subset construction.
+ *
+ * The regex is treated as a sequence of "positions":  position 0 is the start
+ * of the regex, and position p > 0 means "the last character consumed was
+ * matched by operator p - 1".  Since every operator consumes exactly one
+ * character per repetition, the set of positions reachable after each
+ * character is all the state the matcher needs, and the DFA states are the
+ * distinct sets that can arise.
+ *
+ * Each set carries one extra flag bit marking the unanchored half of the
+ * automaton, in which position 0 is added back after every character.
+ *
+ * If more than maxStates states would be needed, construction stops and ok()
+ * reports false.
+ */
+DFA::DFA(const vector<RegexOperator *> &regex, int maxStates) {
+    vector<RegexStep> steps = flattenRegex(regex);
+    int n = steps.size();
+
+    byteClass = nullptr;
+    trans = nullptr;
+    accept = nullptr;
+    numClasses = 0;
+    numStates = 0;
+    anchoredStart = DEAD_STATE;
+    unanchoredStart = DEAD_STATE;
+
+    // The position construction only handles the repeat counts the parser
+    // can produce.
+    for (const RegexStep &step : steps) {
+        if (step.minRepeat > 1 ||
+            (step.maxRepeat != 1 && step.maxRepeat != -1))
+            return;
+    }
+
+    // Two bytes are in the same class if every operator either accepts both
+    // or rejects both.  Each class is represented by its lowest byte.
+    map<vector<bool>, int> classIds;
+    vector<int> representative;
+    ownedClasses.resize(256);
+    for (int c = 0; c < 256; c++) {
+        vector<bool> signature(n);
+        for (int j = 0; j < n; j++)
+            signature[j] = steps[j].chars[c];
+
+        auto found = classIds.find(signature);
+        if (found == classIds.end()) {
+            classIds[signature] = representative.size();
+            ownedClasses[c] = representative.size();
+            representative.push_back(c);
+        }
+        else {
+            ownedClasses[c] = found->second;
+        }
+    }
+    numClasses = representative.size();
+
+    // For each position, the positions that the next character can move to,
+    // and whether the regex can end there.
+    vector<vector<int>> follow(n + 1);
+    vector<bool> final(n + 1);
+    for (int p = 0; p <= n; p++) {
+        if (p > 0 && steps[p - 1].maxRepeat == -1)
+            follow[p].push_back(p);
+
+        for (int j = p; j < n; j++) {
+            follow[p].push_back(j + 1);
+            if (steps[j].minRepeat != 0)
+                break;
+        }
+
+        final[p] = true;
+        for (int j = p; j < n; j++) {
+            if (steps[j].minRepeat != 0)
+                final[p] = false;
+        }
+    }
+
+    // Index n + 1 of each set is the unanchored flag.
+    map<vector<bool>, int> stateIds;
+    vector<vector<bool>> states;
+
+    vector<bool> dead(n + 2, false);
+    stateIds[dead] = DEAD_STATE;
+    states.push_back(dead);
+
+    vector<bool> start(n + 2, false);
+    start[0] = true;
+    anchoredStart = stateIds[start] = states.size();
+    states.push_back(start);
+
+    start[n + 1] = true;
+    unanchoredStart = stateIds[start] = states.size();
+    states.push_back(start);
+
+    // States are numbered in the order they are discovered, so walking the
+    // list also processes every state exactly once.
+    for (int s = 0; s < (int) states.size(); s++) {
+        if ((int) states.size() > maxStates) {
+            ownedClasses.clear();
+            ownedTrans.clear();
+            ownedAccept.clear();
+            numClasses = 0;
+            anchoredStart = DEAD_STATE;
+            unanchoredStart = DEAD_STATE;
+            return;
+        }
+
+        vector<bool> current = states[s];
+        bool unanchored = current[n + 1];
+
+        bool isFinal = false;
+        for (int p = 0; p <= n; p++) {
+            if (current[p] && final[p])
+                isFinal = true;
+        }
+        ownedAccept.push_back(isFinal ? 1 : 0);
+
+        for (int cls = 0; cls < numClasses; cls++) {
+            int c = representative[cls];
+            vector<bool> next(n + 2, false);
+            for (int p = 0; p <= n; p++) {
+                if (!current[p])
+                    continue;
+
+                for (int q : follow[p]) {
+                    if (steps[q - 1].chars[c])
+                        next[q] = true;
+                }
+            }
+
+            if (unanchored) {
+                next[0] = true;
+                next[n + 1] = true;
+            }
+
+            auto found = stateIds.find(next);
+            if (found == stateIds.end()) {
+                int id = states.size();
+                stateIds[next] = id;
+                states.push_back(next);
+                ownedTrans.push_back(id);
+            }
+            else {
+                ownedTrans.push_back(found->second);
+            }
+        }
+    }
+
+    numStates = states.size();
+    minimize();
+
+    byteClass = ownedClasses.data();
+    trans = ownedTrans.data();
+    accept = ownedAccept.data();
+}
+
+
+/* Merges equivalent states with Hopcroft's partition-refinement algorithm.
+ *
+ * States start out split into accepting and non-accepting blocks.  Each
+ * block taken from the worklist is used as a splitter:  for every byte
+ * class, any block containing both states that move into the splitter and
+ * states that do not is split in two, and the smaller half is queued (both
+ * halves, if the block was still queued).  When the worklist is empty, the
+ * states in each block are indistinguishable and become one state.  The
+ * dead state's block stays state 0.
+ */
+void DFA::minimize() {
+    int n = numStates;
+    int k = numClasses;
+
+    // Reverse transitions, grouped by class and then by target state:  the
+    // states moving into q on class c are
+    // inverse[inverseStart[c * (n + 1) + q]] .. up to the next q.
+    vector<int> inverseStart((size_t) k * (n + 1) + 1, 0);
+    vector<int> inverse((size_t) n * k);
+    for (int p = 0; p < n; p++) {
+        for (int c = 0; c < k; c++) {
+            size_t q = ownedTrans[(size_t) p * k + c];
+            inverseStart[(size_t) c * (n + 1) + q + 1]++;
+        }
+    }
+    for (size_t i = 1; i < inverseStart.size(); i++)
+        inverseStart[i] += inverseStart[i - 1];
+    vector<int> fill(inverseStart.begin(), inverseStart.end() - 1);
+    for (int p = 0; p < n; p++) {
+        for (int c = 0; c < k; c++) {
+            size_t q = ownedTrans[(size_t) p * k + c];
+            inverse[fill[(size_t) c * (n + 1) + q]++] = p;
+        }
+    }
+
+    vector<vector<int>> blocks;
+    vector<int> blockOf(n);
+    vector<int> acceptingStates, otherStates;
+    for (int p = 0; p < n; p++) {
+        if (ownedAccept[p])
+            acceptingStates.push_back(p);
+        else
+            otherStates.push_back(p);
+    }
+    for (const vector<int> &b : { acceptingStates, otherStates }) {
+        if (b.empty())
+            continue;
+        for (int p : b)
+            blockOf[p] = blocks.size();
+        blocks.push_back(b);
+    }
+
+    vector<int> worklist;
+    vector<bool> queued(blocks.size(), true);
+    for (int b = 0; b < (int) blocks.size(); b++)
+        worklist.push_back(b);
+
+    vector<bool> marked(n, false);
+    vector<vector<int>> markedIn;
+    vector<int> touched;
+
+    while (!worklist.empty()) {
+        int splitter = worklist.back();
+        worklist.pop_back();
+        queued[splitter] = false;
+        vector<int> members = blocks[splitter];
+
+        for (int c = 0; c < k; c++) {
+            // Mark every state that moves into the splitter on class c,
+            // grouped by the block it is in.
+            markedIn.resize(blocks.size());
+            for (int q : members) {
+                size_t row = (size_t) c * (n + 1) + q;
+                for (int i = inverseStart[row]; i < inverseStart[row + 1];
+                     i++) {
+                    int p = inverse[i];
+                    if (marked[p])
+                        continue;
+                    marked[p] = true;
+
+                    int b = blockOf[p];
+                    if (markedIn[b].empty())
+                        touched.push_back(b);
+                    markedIn[b].push_back(p);
+                }
+            }
+
+            for (int b : touched) {
+                if (markedIn[b].size() < blocks[b].size()) {
+                    int split = blocks.size();
+                    vector<int> rest;
+                    for (int p : blocks[b]) {
+                        if (!marked[p])
+                            rest.push_back(p);
+                    }
+                    blocks[b] = rest;
+                    blocks.push_back(markedIn[b]);
+                    for (int p : blocks[split])
+                        blockOf[p] = split;
+
+                    queued.push_back(false);
+                    if (queued[b] || blocks[split].size() <= rest.size()) {
+                        worklist.push_back(split);
+                        queued[split] = true;
+                    }
+                    else {
+                        worklist.push_back(b);
+                        queued[b] = true;
+                    }
+                }
+
+                for (int p : markedIn[b])
+                    marked[p] = false;
+                markedIn[b].clear();
+            }
+            touched.clear();
+        }
+    }
+
+    // Number the new states in order of their lowest old state, which puts
+    // the dead state's block first.
+    vector<int> newId(blocks.size(), -1);
+    int count = 0;
+    for (int p = 0; p < n; p++) {
+        if (newId[blockOf[p]] == -1)
+            newId[blockOf[p]] = count++;
+    }
+
+    vector<uint32_t> minTrans((size_t) count * k);
+    vector<uint8_t> minAccept(count);
+    for (int p = 0; p < n; p++) {
+        int id = newId[blockOf[p]];
+        minAccept[id] = ownedAccept[p];
+        for (int c = 0; c < k; c++) {
+            minTrans[(size_t) id * k + c] =
+                newId[blockOf[ownedTrans[(size_t) p * k + c]]];
+        }
+    }
+
+    ownedTrans.swap(minTrans);
+    ownedAccept.swap(minAccept);
+    anchoredStart = newId[blockOf[anchoredStart]];
+    unanchoredStart = newId[blockOf[unanchoredStart]];
+    numStates = count;
+}
+
+
+/* Wraps existing tables in a DFA without copying them.  The caller must keep
+ * the tables alive for as long as the DFA is used.
+ */
+DFA::DFA(int numStates, int numClasses, int anchoredStart,
+         int unanchoredStart, const uint8_t *byteClass, const uint32_t *trans,
+         const uint8_t *accept) {
+    this->numStates = numStates;
+    this->numClasses = numClasses;
+    this->anchoredStart = anchoredStart;
+    this->unanchoredStart = unanchoredStart;
+    this->byteClass = byteClass;
+    this->trans = trans;
+    this->accept = accept;
+}
+
+
+bool DFA::ok() const {
+    return numStates > 0;
+}
+
+int DFA::getNumStates() const {
+    return numStates;
+}
+
+int DFA::getNumClasses() const {
+    return numClasses;
+}
+
+int DFA::getAnchoredStart() const {
+    return anchoredStart;
+}
+
+int DFA::getUnanchoredStart() const {
+    return unanchoredStart;
+}
+
+const uint8_t * DFA::getByteClasses() const {
+    return byteClass;
+}
+
+const uint32_t * DFA::getTransitions() const {
+    return trans;
+}
+
+const uint8_t * DFA::getAccepting() const {
+    return accept;
+}
+
+
+/* Runs the anchored automaton from index start, and returns the end of the
+ * longest match beginning there, or -1 if there is none.
+ */
+int64_t DFA::longestAt(const char *data, int64_t length, int64_t start) const {
+    uint32_t state = anchoredStart;
+    int64_t lastEnd = accept[state] ? start : -1;
+
+    for (int64_t i = start; i < length; i++) {
+        state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+        if (state == DEAD_STATE)
+            break;
+
+        if (accept[state])
+            lastEnd = i + 1;
+    }
+
+    return lastEnd;
+}
+
+
+/* Returns true if some match starts at index start.  Unlike longestAt(),
+ * this stops at the first accepting state.
+ */
+bool DFA::matchesAt(const char *data, int64_t length, int64_t start) const {
+    uint32_t state = anchoredStart;
+    if (accept[state])
+        return true;
+
+    for (int64_t i = start; i < length; i++) {
+        state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+        if (state == DEAD_STATE)
+            return false;
+        if (accept[state])
+            return true;
+    }
+    return false;
+}
+
+
+/* Finds the leftmost, longest match of the regex in s that starts at or
+ * after index from.  For the operators this engine supports, that is exactly
+ * the match the backtracking engine reports.  This is parallelFind() on a
+ * single thread.
+ */
+Range DFA::find(const string &s, int from) const {
+    BufferRange r = parallelFind(s.data() + from, s.length() - from, 1);
+    if (r.start == -1)
+        return Range(-1, -1);
+    return Range(from + r.start, from + r.end);
+}
+
+
+/* Returns true if the regex matches all of s. */
+bool DFA::match(const string &s) const {
+    assert(ok());
+
+    if (s.empty())
+        return false;
+
+    return longestAt(s.data(), s.length(), 0) == (int64_t) s.length();
+}
+
+
+/* The speculative scan of one segment of the input, started from the
+ * unanchored start state rather than from the state the previous segment
+ * actually ends in.
+ */
+struct SegmentScan {
+    int64_t begin, end;
+
+    // The state on entry to every CHECKPOINT_INTERVAL'th byte.
+    vector<uint32_t> checkpoints;
+
+    // The end of the first match seen, or -1; the scan stops there.
+    int64_t firstAccept;
+
+    // The state after the last byte, if no match was seen.
+    uint32_t exitState;
+};
+
+static const int64_t CHECKPOINT_INTERVAL = 4096;
+
+// firstEnd() scans this much on the calling thread before splitting the rest.
+static const int64_t PROBE_LENGTH = 16 * CHECKPOINT_INTERVAL;
+
+
+/* Returns the number of threads to use when the caller asks for 0. */
+static int defaultThreads() {
+    int n = thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+
+/* Runs fn(0) .. fn(n - 1), each on its own thread except the first, which
+ * runs on the calling thread.
+ */
+template <typename F>
+static void runParallel(int n, F fn) {
+    vector<thread> workers;
+    for (int i = 1; i < n; i++)
+        workers.push_back(thread(fn, i));
+    fn(0);
+    for (thread &t : workers)
+        t.join();
+}
+
+
+/* Returns the end of the earliest-ending match in the buffer, or -1.
+ *
+ * The first PROBE_LENGTH bytes are scanned on this thread, so that a
+ * search with a match close by does not start any threads.  The rest of
+ * the buffer is split into one segment per thread, and every segment is
+ * scanned at once from the unanchored start state.  That is only a guess at
+ * the state each segment is entered in, so a sequential fix-up pass re-runs
+ * each segment from its true entry state only until the two runs agree at a
+ * checkpoint, after which the speculative results are known to hold.  The
+ * unanchored automaton forgets its history quickly, so the fix-up usually
+ * touches only the first checkpoint of each segment.
+ *
+ * The true run is in every state the speculative run of a segment is in,
+ * and more, so a speculative match end is never earlier than the true
+ * first end.  Once a segment has seen a match, the threads scanning later
+ * segments therefore give up at their next checkpoint.
+ */
+int64_t DFA::firstEnd(const char *data, int64_t length, int numThreads) const {
+    if (accept[unanchoredStart])
+        return 0;
+
+    // A match near the start is found without starting any threads.
+    uint32_t state = unanchoredStart;
+    int64_t probeEnd = min(length, PROBE_LENGTH);
+    for (int64_t i = 0; i < probeEnd; i++) {
+        state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+        if (accept[state])
+            return i + 1;
+    }
+
+    int64_t rest = length - probeEnd;
+    int numSegments = min((int64_t) numThreads,
+                          max((int64_t) 1, rest / MIN_SEGMENT_LENGTH));
+    vector<SegmentScan> scans(numSegments);
+    atomic<int> acceptSegment(numSegments);
+
+    runParallel(numSegments, [&](int k) {
+        SegmentScan &scan = scans[k];
+        scan.begin = probeEnd + rest * k / numSegments;
+        scan.end = probeEnd + rest * (k + 1) / numSegments;
+        scan.firstAccept = -1;
+
+        uint32_t state = unanchoredStart;
+        for (int64_t i = scan.begin; i < scan.end; i++) {
+            if ((i - scan.begin) % CHECKPOINT_INTERVAL == 0) {
+                if (acceptSegment.load(memory_order_relaxed) < k)
+                    break;
+                scan.checkpoints.push_back(state);
+            }
+
+            state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+            if (accept[state]) {
+                scan.firstAccept = i + 1;
+                int current = acceptSegment.load();
+                while (k < current &&
+                       !acceptSegment.compare_exchange_weak(current, k)) { }
+                break;
+            }
+        }
+        scan.exitState = state;
+    });
+
+    for (const SegmentScan &scan : scans) {
+        bool converged = false;
+        for (int64_t i = scan.begin; i < scan.end; i++) {
+            int64_t offset = i - scan.begin;
+            if (offset % CHECKPOINT_INTERVAL == 0) {
+                size_t k = offset / CHECKPOINT_INTERVAL;
+                if (k < scan.checkpoints.size() &&
+                    scan.checkpoints[k] == state) {
+                    converged = true;
+                    break;
+                }
+            }
+
+            state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+            if (accept[state])
+                return i + 1;
+        }
+
+        if (converged) {
+            if (scan.firstAccept != -1)
+                return scan.firstAccept;
+            state = scan.exitState;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Builds the reversed automaton by subset construction over this one's
+ * anchored half with every transition turned around.  Each reversed state
+ * is the set of states from which the bytes read so far, in reverse, lead
+ * to an accepting state, so it accepts when the set holds the anchored
+ * start.  Since every state in the anchored half is reachable, the result
+ * is the minimal DFA for the reversed regex (Brzozowski), no larger than
+ * the forward one usually is.  If it would need more than
+ * DEFAULT_MAX_STATES states, it is left empty.
+ */
+void DFA::buildReversed() const {
+    int n = numStates;
+    int k = numClasses;
+
+    vector<bool> reachable(n, false);
+    vector<uint32_t> stack(1, anchoredStart);
+    reachable[anchoredStart] = true;
+    while (!stack.empty()) {
+        uint32_t p = stack.back();
+        stack.pop_back();
+        for (int c = 0; c < k; c++) {
+            uint32_t q = trans[(size_t) p * k + c];
+            if (!reachable[q]) {
+                reachable[q] = true;
+                stack.push_back(q);
+            }
+        }
+    }
+
+    // The predecessors of state q on class c are
+    // preds[predStart[c * n + q] .. predStart[c * n + q + 1]).
+    vector<uint32_t> predStart((size_t) k * n + 1, 0);
+    for (int p = 0; p < n; p++) {
+        if (!reachable[p])
+            continue;
+        for (int c = 0; c < k; c++)
+            predStart[(size_t) c * n + trans[(size_t) p * k + c] + 1]++;
+    }
+    for (size_t i = 1; i < predStart.size(); i++)
+        predStart[i] += predStart[i - 1];
+    vector<uint32_t> preds(predStart.back());
+    vector<uint32_t> fill(predStart.begin(), predStart.end() - 1);
+    for (int p = 0; p < n; p++) {
+        if (!reachable[p])
+            continue;
+        for (int c = 0; c < k; c++)
+            preds[fill[(size_t) c * n + trans[(size_t) p * k + c]]++] = p;
+    }
+
+    // The sets are sorted lists of states; the empty set is the dead state.
+    map<vector<uint32_t>, int> setIds;
+    vector<vector<uint32_t>> sets(1);
+    setIds[sets[0]] = DEAD_STATE;
+
+    vector<uint32_t> start;
+    for (int p = 0; p < n; p++) {
+        if (reachable[p] && accept[p])
+            start.push_back(p);
+    }
+    auto found = setIds.find(start);
+    if (found == setIds.end()) {
+        reversed.start = setIds[start] = sets.size();
+        sets.push_back(start);
+    }
+    else {
+        reversed.start = found->second;
+    }
+
+    vector<bool> inNext(n, false);
+    for (size_t i = 0; i < sets.size(); i++) {
+        if ((int) sets.size() > DEFAULT_MAX_STATES) {
+            reversed.trans.clear();
+            reversed.accept.clear();
+            return;
+        }
+
+        vector<uint32_t> current = sets[i];
+        reversed.accept.push_back(
+            binary_search(current.begin(), current.end(),
+                          (uint32_t) anchoredStart) ? 1 : 0);
+
+        for (int c = 0; c < k; c++) {
+            vector<uint32_t> next;
+            for (uint32_t q : current) {
+                size_t at = (size_t) c * n + q;
+                for (uint32_t j = predStart[at]; j < predStart[at + 1]; j++) {
+                    uint32_t p = preds[j];
+                    if (!inNext[p]) {
+                        inNext[p] = true;
+                        next.push_back(p);
+                    }
+                }
+            }
+            for (uint32_t p : next)
+                inNext[p] = false;
+            sort(next.begin(), next.end());
+
+            found = setIds.find(next);
+            if (found == setIds.end()) {
+                int id = sets.size();
+                setIds[next] = id;
+                sets.push_back(next);
+                reversed.trans.push_back(id);
+            }
+            else {
+                reversed.trans.push_back(found->second);
+            }
+        }
+    }
+}
+
+
+/* Returns the smallest start index in [0, last] at which an anchored match
+ * exists, or -1, given that end is where the earliest-ending match ends.
+ *
+ * The leftmost match can always be cut short to end at end as well:  this
+ * engine's regexes are sequences of single-byte steps, so where a later,
+ * earlier-ending match catches up with the leftmost one, the leftmost one
+ * can follow it from there.  So the reversed automaton is run backward from
+ * end, and the last point at which it accepts is the start.  The scan stops
+ * as soon as no match can end at end, which is usually just past the
+ * match's start.
+ *
+ * If the reversed automaton is too large to build, each start is tried
+ * with the anchored automaton instead, divided among the threads; a thread
+ * gives up once a thread with lower starts has found one.
+ */
+int64_t DFA::leftmostStart(const char *data, int64_t length, int64_t end,
+                           int64_t last, int numThreads) const {
+    call_once(reversedBuilt, [this] { buildReversed(); });
+
+    if (!reversed.trans.empty()) {
+        uint32_t state = reversed.start;
+        int64_t start = -1;
+        for (int64_t i = end; ; i--) {
+            if (reversed.accept[state] && i <= last)
+                start = i;
+            if (i == 0)
+                break;
+            state = reversed.trans[state * numClasses +
+                                   byteClass[(unsigned char) data[i - 1]]];
+            if (state == DEAD_STATE)
+                break;
+        }
+        return start;
+    }
+
+    int64_t count = last + 1;
+    int numChunks = min((int64_t) numThreads,
+                        max((int64_t) 1, count / MIN_SEGMENT_LENGTH));
+    vector<int64_t> found(numChunks, -1);
+    atomic<int> firstFoundChunk(numChunks);
+
+    runParallel(numChunks, [&](int k) {
+        int64_t begin = count * k / numChunks;
+        int64_t end = count * (k + 1) / numChunks;
+        for (int64_t start = begin; start < end; start++) {
+            if (firstFoundChunk.load(memory_order_relaxed) < k)
+                return;
+
+            if (matchesAt(data, length, start)) {
+                found[k] = start;
+                int current = firstFoundChunk.load();
+                while (k < current &&
+                       !firstFoundChunk.compare_exchange_weak(current, k)) { }
+                return;
+            }
+        }
+    });
+
+    for (int64_t start : found) {
+        if (start != -1)
+            return start;
+    }
+    return -1;
+}
+
+
+/* The speculative scan of one segment of a match being extended, which
+ * follows every state the anchored automaton might enter the segment in.
+ * Runs that reach the same state are merged, since they behave alike from
+ * then on; runs that reach the dead state stop.
+ */
+struct ExtensionScan {
+    vector<int> runOf;          // the run followed from each entry state
+    vector<uint32_t> state;     // each run's current state
+    vector<int64_t> lastAccept; // each run's last accepting end, or -1
+    vector<int> mergedInto;     // the run it joined, or -1
+    vector<int64_t> mergedAt;   // where it joined
+};
+
+
+/* Returns the state a run ends the segment in, and sets lastEnd to the end
+ * of the last accepting state it saw, if it saw any.  A run that was merged
+ * takes the result of the run it joined, unless that run last accepted
+ * before the merge.
+ */
+static uint32_t resolveRun(const ExtensionScan &scan, int run,
+                           int64_t &lastEnd) {
+    if (scan.mergedInto[run] == -1) {
+        if (scan.lastAccept[run] != -1)
+            lastEnd = scan.lastAccept[run];
+        return scan.state[run];
+    }
+
+    int64_t joinedEnd = -1;
+    uint32_t exitState = resolveRun(scan, scan.mergedInto[run], joinedEnd);
+    if (joinedEnd > scan.mergedAt[run])
+        lastEnd = joinedEnd;
+    else if (scan.lastAccept[run] != -1)
+        lastEnd = scan.lastAccept[run];
+    return exitState;
+}
+
+
+/* Returns the same as longestAt(), using up to numThreads threads for long
+ * matches.  The first MIN_SEGMENT_LENGTH bytes are scanned on this thread,
+ * since most matches end well before that.  If the match is still going,
+ * the rest of the buffer is split into segments:  the first is scanned from
+ * the true state, and each of the others from every state reachable from
+ * the anchored start at once.  The segments are then chained together in
+ * order.  A segment in which every run dies ends the search, so the threads
+ * scanning later segments give up.
+ */
+int64_t DFA::parallelLongestAt(const char *data, int64_t length,
+                               int64_t start, int numThreads) const {
+    if (numThreads <= 1 || numStates > MAX_SPECULATIVE_STATES ||
+        length - start < 3 * MIN_SEGMENT_LENGTH)
+        return longestAt(data, length, start);
+
+    uint32_t state = anchoredStart;
+    int64_t lastEnd = accept[state] ? start : -1;
+    int64_t probeEnd = start + MIN_SEGMENT_LENGTH;
+    for (int64_t i = start; i < probeEnd; i++) {
+        state = trans[state * numClasses + byteClass[(unsigned char) data[i]]];
+        if (state == DEAD_STATE)
+            return lastEnd;
+        if (accept[state])
+            lastEnd = i + 1;
+    }
+
+    // The states the anchored automaton can ever be in.
+    vector<uint32_t> reachable(1, anchoredStart);
+    vector<bool> seen(numStates, false);
+    seen[anchoredStart] = true;
+    for (size_t k = 0; k < reachable.size(); k++) {
+        for (int c = 0; c < numClasses; c++) {
+            uint32_t next = trans[reachable[k] * numClasses + c];
+            if (next != DEAD_STATE && !seen[next]) {
+                seen[next] = true;
+                reachable.push_back(next);
+            }
+        }
+    }
+
+    int64_t rest = length - probeEnd;
+    int numSegments = min((int64_t) numThreads,
+                          max((int64_t) 1, rest / MIN_SEGMENT_LENGTH));
+    vector<ExtensionScan> scans(numSegments);
+    atomic<int> deadSegment(numSegments);
+
+    runParallel(numSegments, [&](int k) {
+        ExtensionScan &scan = scans[k];
+        int64_t begin = probeEnd + rest * k / numSegments;
+        int64_t end = probeEnd + rest * (k + 1) / numSegments;
+
+        // The first segment has only the true entry state to follow.
+        scan.runOf.assign(numStates, -1);
+        vector<int> live;
+        for (uint32_t s : reachable) {
+            if (k == 0 && s != state)
+                continue;
+            scan.runOf[s] = live.size();
+            live.push_back(live.size());
+            scan.state.push_back(s);
+            scan.lastAccept.push_back(-1);
+            scan.mergedInto.push_back(-1);
+            scan.mergedAt.push_back(-1);
+        }
+
+        vector<int> owner(numStates, -1);
+        vector<int> next;
+        for (int64_t i = begin; i < end && !live.empty(); i++) {
+            if ((i - begin) % CHECKPOINT_INTERVAL == 0 &&
+                deadSegment.load(memory_order_relaxed) < k)
+                return;
+
+            // Once the runs have all merged, one is followed as cheaply as
+            // in longestAt().
+            if (live.size() == 1) {
+                int run = live[0];
+                uint32_t s = scan.state[run];
+                int64_t runAccept = scan.lastAccept[run];
+                while (i < end && s != DEAD_STATE) {
+                    if (deadSegment.load(memory_order_relaxed) < k)
+                        return;
+                    int64_t stop = min(end, i + CHECKPOINT_INTERVAL);
+                    for (; i < stop; i++) {
+                        s = trans[s * numClasses +
+                                  byteClass[(unsigned char) data[i]]];
+                        if (s == DEAD_STATE)
+                            break;
+                        if (accept[s])
+                            runAccept = i + 1;
+                    }
+                }
+                scan.state[run] = s;
+                scan.lastAccept[run] = runAccept;
+                if (s == DEAD_STATE)
+                    live.clear();
+                break;
+            }
+
+            int c = byteClass[(unsigned char) data[i]];
+            next.clear();
+            for (int run : live) {
+                uint32_t s = trans[scan.state[run] * numClasses + c];
+                scan.state[run] = s;
+                if (s == DEAD_STATE)
+                    continue;
+                if (accept[s])
+                    scan.lastAccept[run] = i + 1;
+                if (owner[s] != -1) {
+                    scan.mergedInto[run] = owner[s];
+                    scan.mergedAt[run] = i + 1;
+                    continue;
+                }
+                owner[s] = run;
+                next.push_back(run);
+            }
+            for (int run : next)
+                owner[scan.state[run]] = -1;
+            live.swap(next);
+        }
+
+        if (live.empty()) {
+            int current = deadSegment.load();
+            while (k < current &&
+                   !deadSegment.compare_exchange_weak(current, k)) { }
+        }
+    });
+
+    for (const ExtensionScan &scan : scans) {
+        state = resolveRun(scan, scan.runOf[state], lastEnd);
+        if (state == DEAD_STATE)
+            break;
+    }
+    return lastEnd;
+}
+
+
+/* Finds the same match as find(), in a buffer of any size, using up to
+ * numThreads threads (0 means one per core).
+ *
+ * An unanchored pass finds where the earliest-ending match ends; no match can
+ * start after that point, and a backward scan from it finds the leftmost
+ * start.  Inputs with no match are rejected in one linear pass, split
+ * across the threads.  The match found is then extended to its
+ * longest end, also across the threads if it is long.
+ */
+BufferRange DFA::parallelFind(const char *data, size_t length,
+                              int numThreads) const {
+    assert(ok());
+
+    if (numThreads <= 0)
+        numThreads = defaultThreads();
+
+    BufferRange none = { -1, -1 };
+    int64_t len = length;
+    int64_t end = firstEnd(data, len, numThreads);
+    if (end == -1 || len == 0)
+        return none;
+
+    // Like the backtracking engine, never report a match starting at the
+    // very end of the buffer.
+    int64_t start = leftmostStart(data, len, end, min(end, len - 1),
+                                  numThreads);
+    if (start == -1)
+        return none;
+
+    BufferRange r = { start,
+                      parallelLongestAt(data, len, start, numThreads) };
+    return r;
+}
+
+
+Range DFA::parallelFind(const string &s, int numThreads) const {
+    BufferRange r = parallelFind(s.data(), s.length(), numThreads);
+    return Range(r.start, r.end);
+}
@@ -0,0 +1,120 @@
+#ifndef DFA_HH
+#define DFA_HH
+
+#include "regex.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+/* Like Range, but for offsets into buffers too large to index with an int.
+ * A start and end of -1 indicate no match.
+ */
+struct BufferRange {
+    int64_t start;
+    int64_t end;
+};
+
+
+/* A deterministic finite automaton equivalent to a parsed regex.  The DFA is
+ * built by subset construction over the regex's positions, and contains two
+ * start states:  an "anchored" start that only matches at the current index,
+ * and an "unanchored" start that behaves as if the regex were prefixed with
+ * ".*", so that a single pass reports whether a match exists anywhere.
+ *
+ * The automaton is minimized after construction, and its columns are byte
+ * classes rather than bytes:  bytes that every operator treats alike share a
+ * class, so a pattern that names only a few characters has only a few
+ * columns.  The transition table is a flat array of numStates * numClasses
+ * entries, and state 0 is always the dead state.  The tables are either owned
+ * by the DFA (when it is built from a regex), or are a read-only view of
+ * memory owned by someone else, such as a mapped DFA file.
+ *
+ * find() and match() give the same results as the backtracking engine.
+ * parallelFind() splits the first and last stages of the search across
+ * threads:  finding where the first match ends, and extending the match
+ * found as far as it goes.  In between, the match's start is found by one
+ * backward scan from that end with the reversed automaton, which is built
+ * the first time a search needs it, so loading a DFA file stays cheap.
+ */
+class DFA {
+    // Storage used when the DFA is built from a regex.
+    vector<uint8_t> ownedClasses;
+    vector<uint32_t> ownedTrans;
+    vector<uint8_t> ownedAccept;
+
+    // The tables used for matching.
+    const uint8_t *byteClass;
+    const uint32_t *trans;
+    const uint8_t *accept;
+
+    int numClasses;
+    int numStates;
+    int anchoredStart;
+    int unanchoredStart;
+
+    // The reversed automaton, over the same byte classes.  Its state 0 is
+    // dead, and its tables are empty if it would need too many states.
+    struct Reversed {
+        vector<uint32_t> trans;
+        vector<uint8_t> accept;
+        int start;
+    };
+    mutable Reversed reversed;
+    mutable once_flag reversedBuilt;
+
+    // Copying would leave the table pointers aimed at the original.
+    DFA(const DFA &);
+    DFA & operator=(const DFA &);
+
+    void minimize();
+    void buildReversed() const;
+
+    int64_t longestAt(const char *data, int64_t length, int64_t start) const;
+    bool matchesAt(const char *data, int64_t length, int64_t start) const;
+    int64_t parallelLongestAt(const char *data, int64_t length,
+                              int64_t start, int numThreads) const;
+    int64_t firstEnd(const char *data, int64_t length, int numThreads) const;
+    int64_t leftmostStart(const char *data, int64_t length, int64_t end,
+                          int64_t last, int numThreads) const;
+
+public:
+    static const int DEAD_STATE = 0;
+    static const int DEFAULT_MAX_STATES = 10000;
+
+    DFA(const vector<RegexOperator *> &regex,
+        int maxStates = DEFAULT_MAX_STATES);
+    DFA(int numStates, int numClasses, int anchoredStart,
+        int unanchoredStart, const uint8_t *byteClass, const uint32_t *trans,
+        const uint8_t *accept);
+
+    // False if construction gave up because of the state limit.
+    bool ok() const;
+
+    int getNumStates() const;
+    int getNumClasses() const;
+    int getAnchoredStart() const;
+    int getUnanchoredStart() const;
+    const uint8_t * getByteClasses() const;
+    const uint32_t * getTransitions() const;
+    const uint8_t * getAccepting() const;
+
+    Range find(const string &s, int from = 0) const;
+    bool match(const string &s) const;
+
+    // Inputs shorter than this per thread are searched on one thread.
+    static const int64_t MIN_SEGMENT_LENGTH = 1 << 20;
+
+    // A match longer than MIN_SEGMENT_LENGTH is only extended in parallel
+    // by automata with at most this many states, since each thread follows
+    // every state the anchored automaton can be in at once.
+    static const int MAX_SPECULATIVE_STATES = 64;
+
+    BufferRange parallelFind(const char *data, size_t length,
+                             int numThreads) const;
+    Range parallelFind(const string &s, int numThreads = 0) const;
+};
+
+
+#endif // DFA_HH
@@ -1,5 +1,7 @@
 #include "engine.hh"
+#include "literal.hh"
 
+#include <cstring>
 #include <iostream>
 
 
@@ -9,6 +11,36 @@
 #define VERBOSE 0
 
 
+/* Returns how many of btOp's matches to undo when backtracking into it, given
+ * that next is the operator after it.
+ *
+ * Normally this is one, so that every shorter run of btOp is retried.  But if
+ * next must match a single literal character c, every retry at an index not
+ * holding c fails straight away, so the engine jumps directly to the last
+ * earlier c with a reverse scan.  This turns patterns like "a.*c" from one
+ * backtracking step per character into a single memrchr().  Only repeated
+ * operators are backtracked into, and each of those consumes exactly one
+ * character per match, so btOp's matches are the consecutive characters
+ * before end.  If next is a fused run of characters, its first one is used.
+ */
+static int backtrackCount(RegexOperator *btOp, RegexOperator *next,
+                          const string &s) {
+    string text;
+    if (next->getMinRepeat() < 1 || !next->getLiteralText(text))
+        return 1;
+    char c = text[0];
+
+    int end = btOp->lastMatch().end;
+    int undoable = btOp->numMatches() - btOp->getMinRepeat();
+    const char *found =
+        (const char *) memrchr(s.data() + end - undoable, c, undoable);
+    if (found == nullptr)
+        return undoable;
+
+    return end - (found - s.data());
+}
+
+
 /* This helper function implements the core of the regular-expression matching
  * algorithm, a simple backtracking algorithm that will attempt to consume as
  * much of the input string as possible, but will backtrack where it can if it
@@ -18,8 +50,11 @@
  * start.
  *
  * If the function cannot generate a match, it will return the range (-1, -1).
+ *
+ * The work done is added to stats.
  */
-Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start) {
+Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start,
+                  EngineStats &stats) {
     if (VERBOSE) {
         cout << string(78, '-') << endl;
         cout << "Find regex in \"" << s << "\", starting at index " << start
@@ -51,6 +86,7 @@ Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start) {
             Range iter(currentOp.end, currentOp.end);
             // If we get a match, record the range that we match on, so that
             // we can backtrack if needed.
+            stats.steps++;
             if (op->match(s, iter)) {
                 op->pushMatch(iter);
 
@@ -106,7 +142,9 @@ Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start) {
                              << " required); trying one less" << endl;
                     }
 
-                    Range popped = btOp->popMatch();
+                    Range popped = btOp->popMatches(
+                        backtrackCount(btOp, regex[opIndex], s));
+                    stats.backtracks++;
                     currentOp.end = popped.start;
                     matched.end = popped.start;
 
@@ -153,11 +191,36 @@ Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start) {
 
 Range find(vector<RegexOperator *> regex, const string &s)
 {
+    EngineStats stats;
+    return find(regex, s, stats);
+}
+
+/* Same as find(), but also adds the work done to stats.
+ *
+ * A regex that is a plain literal has only one possible match at each index,
+ * so it is handed to a substring search instead of being tried at every
+ * index; no operator steps are taken in that case.  The searcher is built
+ * for this one call, so code that searches with the same regex repeatedly
+ * should use a CompiledRegex or RegexBatch, which build it once.
+ */
+Range find(vector<RegexOperator *> regex, const string &s, EngineStats &stats)
+{
+    string literal;
+    if(getLiteral(regex, literal) && !literal.empty())
+    {
+        int index = LiteralSearcher(literal).find(s);
+        if(index == -1)
+        {
+            return Range(-1, -1);
+        }
+        return Range(index, index + literal.length());
+    }
+
     int sLen = s.length();
     Range result(-1, -1);
     for(int i = 0; i < sLen; i++)
     {
-        Range result = findAtIndex(regex, s, i);
+        Range result = findAtIndex(regex, s, i, stats);
         if(result.start != -1 && result.end != -1)
         {
             return result;
@@ -1,6 +1,26 @@
+#ifndef ENGINE_HH
+#define ENGINE_HH
+
 #include "regex.hh"
 
 
+/* Counts the work done by the backtracking engine, so that patterns whose
+ * cost grows quickly with the input can be spotted.
+ */
+struct EngineStats {
+    long steps;         // calls to an operator's match()
+    long backtracks;    // operator applications undone while backtracking
+
+    EngineStats() : steps(0), backtracks(0) { }
+};
+
+
+Range findAtIndex(vector<RegexOperator *> regex, const string &s, int start,
+                  EngineStats &stats);
 Range find(vector<RegexOperator *> regex, const string &s);
+Range find(vector<RegexOperator *> regex, const string &s,
+           EngineStats &stats);
 bool match(vector<RegexOperator *> regex, const string &s);
 
+
+#endif // ENGINE_HH
@@ -0,0 +1,64 @@
+#include "literal.hh"
+
+#include <cstring>
+
+
+/* Builds the Horspool shift table:  for each byte, how far the window can
+ * move when that byte is the last one in the window.  Short literals never
+ * use it, so it is left unset for them.
+ */
+LiteralSearcher::LiteralSearcher(const string &literal) {
+    this->literal = literal;
+
+    int m = literal.length();
+    if (m < HORSPOOL_MIN_LENGTH)
+        return;
+    for (int c = 0; c < 256; c++)
+        shift[c] = m;
+    for (int i = 0; i < m - 1; i++)
+        shift[(unsigned char) literal[i]] = m - 1 - i;
+}
+
+
+int LiteralSearcher::length() const {
+    return literal.length();
+}
+
+
+/* Returns the index of the first occurrence of the literal in s at or after
+ * from, or -1 if there is none.
+ */
+int LiteralSearcher::find(const string &s, int from) const {
+    int n = s.length();
+    int m = literal.length();
+    if (m == 0)
+        return from <= n ? from : -1;
+    if (from > n - m)
+        return -1;
+
+    const char *text = s.data();
+    const char *pat = literal.data();
+
+    if (m < HORSPOOL_MIN_LENGTH) {
+        const char *p = text + from;
+        const char *last = text + n - m;
+        while (p <= last) {
+            p = (const char *) memchr(p, pat[0], last - p + 1);
+            if (p == nullptr)
+                return -1;
+            if (memcmp(p + 1, pat + 1, m - 1) == 0)
+                return p - text;
+            p++;
+        }
+        return -1;
+    }
+
+    unsigned char lastChar = pat[m - 1];
+    for (int i = from; i <= n - m; ) {
+        unsigned char c = text[i + m - 1];
+        if (c == lastChar && memcmp(text + i, pat, m - 1) == 0)
+            return i;
+        i += shift[c];
+    }
+    return -1;
+}
@@ -0,0 +1,30 @@
+#ifndef LITERAL_HH
+#define LITERAL_HH
+
+#include <string>
+
+using namespace std;
+
+
+/* Searches for a fixed string.  Short literals are found by scanning for
+ * their first byte with memchr(), which the C library vectorizes, and
+ * comparing the rest; longer ones use Boyer-Moore-Horspool, which skips up to
+ * the literal's length on each mismatch and so examines only a fraction of
+ * the input.
+ */
+class LiteralSearcher {
+    string literal;
+    int shift[256];
+
+public:
+    // Literals shorter than this use the memchr() scan.
+    static const int HORSPOOL_MIN_LENGTH = 4;
+
+    LiteralSearcher(const string &literal);
+
+    int length() const;
+    int find(const string &s, int from = 0) const;
+};
+
+
+#endif // LITERAL_HH
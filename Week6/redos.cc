@@ -0,0 +1,238 @@
+#include "engine.hh"
+#include "regex-analysis.hh"
+
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <set>
+
+using namespace std;
+
+
+/* This program looks for inputs that make the backtracking engine work as
+ * hard as possible on a pattern, to find patterns that are a denial-of-service
+ * risk before they are deployed.
+ *
+ * For each input length in a doubling series, a random input is improved by
+ * mutation, keeping any change that does not reduce the number of operator
+ * steps find() takes.  The best input for one length seeds the next, and the
+ * growth of the step counts is fitted on a log-log scale.  A slope near 1 is
+ * linear; anything clearly above it is flagged as super-linear, and the
+ * program then exits with status 2 so it can gate a deployment.
+ */
+
+
+// The slope above which the step counts are considered super-linear.
+const double SUPERLINEAR_SLOPE = 1.5;
+
+// The number of mutations tried for each input length.
+const int MUTATIONS_PER_LENGTH = 300;
+
+
+/*! Prints a usage statement for the program. */
+void printUsage(char *name)
+{
+    cerr << "Usage: " << name << " PATTERN [MAX-LENGTH [SEED]]" << endl;
+}
+
+
+/* Chooses the characters that inputs are built from.  Every character named
+ * by a small set (a literal or a bracket class) is included, plus one
+ * printable character for each large set (. and negated classes) and one
+ * printable character that no small set accepts, so that mutations can both
+ * extend and break partial matches.
+ */
+string chooseAlphabet(const vector<RegexStep> &steps)
+{
+    set<char> chars;
+    bitset<256> named;
+
+    for(const RegexStep &step : steps)
+    {
+        if(step.chars.count() <= 16)
+        {
+            for(int c = 0; c < 256; c++)
+            {
+                if(step.chars[c])
+                {
+                    chars.insert((char) c);
+                    named[c] = true;
+                }
+            }
+        }
+    }
+
+    for(const RegexStep &step : steps)
+    {
+        if(step.chars.count() > 16)
+        {
+            for(int c = ' '; c <= '~'; c++)
+            {
+                if(step.chars[c] && !named[c])
+                {
+                    chars.insert((char) c);
+                    break;
+                }
+            }
+        }
+    }
+
+    for(int c = ' '; c <= '~'; c++)
+    {
+        if(!named[c])
+        {
+            chars.insert((char) c);
+            break;
+        }
+    }
+
+    return string(chars.begin(), chars.end());
+}
+
+
+/* Returns the number of operator steps find() takes on the input. */
+long countSteps(const vector<RegexOperator *> &regex, const string &input)
+{
+    EngineStats stats;
+    find(regex, input, stats);
+    return stats.steps;
+}
+
+
+/* Applies one random change to the input, keeping its length:  either a
+ * single character is replaced, or a run is copied from elsewhere in the
+ * input, which spreads a profitable substring around quickly.
+ */
+void mutate(string &input, const string &alphabet)
+{
+    int len = input.length();
+    if(rand() % 2 == 0 || len < 2)
+    {
+        input[rand() % len] = alphabet[rand() % alphabet.length()];
+    }
+    else
+    {
+        int from = rand() % len;
+        int to = rand() % len;
+        int runLength = 1 + rand() % (len - max(from, to));
+        input.replace(to, runLength, input.substr(from, runLength));
+    }
+}
+
+
+/* Searches for the input of the given length that maximizes the number of
+ * steps, starting from seed.
+ */
+string worstInput(const vector<RegexOperator *> &regex, const string &seed,
+                  const string &alphabet, long &bestSteps)
+{
+    string best = seed;
+    bestSteps = countSteps(regex, best);
+
+    for(int i = 0; i < MUTATIONS_PER_LENGTH; i++)
+    {
+        string candidate = best;
+        mutate(candidate, alphabet);
+
+        long steps = countSteps(regex, candidate);
+        if(steps >= bestSteps)
+        {
+            best = candidate;
+            bestSteps = steps;
+        }
+    }
+
+    return best;
+}
+
+
+/* Fits log(steps) = slope * log(length) + c by least squares, and returns
+ * the slope.
+ */
+double growthSlope(const vector<int> &lengths, const vector<long> &steps)
+{
+    int n = lengths.size();
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for(int i = 0; i < n; i++)
+    {
+        double x = log((double) lengths[i]);
+        double y = log((double) max(steps[i], 1L));
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+
+    return (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc < 2 || argc > 4)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    int maxLength = argc > 2 ? atoi(argv[2]) : 256;
+    if(maxLength < 8)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    srand(argc > 3 ? atoi(argv[3]) : time(nullptr));
+
+    vector<RegexOperator *> regex = parseRegex(argv[1]);
+    string alphabet = chooseAlphabet(flattenRegex(regex));
+
+    vector<int> lengths;
+    vector<long> steps;
+    string input;
+
+    cout << "length       steps  worst input" << endl;
+    for(int len = 4; len <= maxLength; len *= 2)
+    {
+        // Grow the previous worst input, so the search starts from a
+        // string that is already known to be expensive.
+        string seed = input;
+        while((int) seed.length() < len)
+        {
+            seed += input.empty() ? alphabet[rand() % alphabet.length()]
+                                  : input[seed.length() % input.length()];
+        }
+
+        long bestSteps;
+        input = worstInput(regex, seed, alphabet, bestSteps);
+        lengths.push_back(len);
+        steps.push_back(bestSteps);
+
+        cout.width(6);
+        cout << len << "  ";
+        cout.width(10);
+        cout << bestSteps << "  \"";
+        if(len <= 32)
+            cout << input;
+        else
+            cout << input.substr(0, 29) << "...";
+        cout << "\"" << endl;
+    }
+
+    RegexComplexity complexity = analyzeRegex(regex);
+    clearRegex(regex);
+
+    double slope = growthSlope(lengths, steps);
+    cout << endl << "Steps grow as length^" << slope
+         << " (static worst case: length^" << complexity.degree << ")"
+         << endl;
+
+    if(slope > SUPERLINEAR_SLOPE)
+    {
+        cout << "SUPER-LINEAR: this pattern is a backtracking risk" << endl;
+        return 2;
+    }
+
+    cout << "Linear" << endl;
+    return 0;
+}
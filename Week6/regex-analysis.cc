@@ -0,0 +1,44 @@
+#include "regex-analysis.hh"
+
+
+/* Finds the longest chain of unbounded repeats that can all take turns
+ * consuming one character c.  For each c, the steps are walked in order:  an
+ * unbounded repeat that accepts c extends the chain, a step that must match
+ * at least once but rejects c breaks it, and any other step can be skipped
+ * over, so it leaves the chain as it is.
+ */
+RegexComplexity analyzeRegex(const vector<RegexOperator *> &regex)
+{
+    vector<RegexStep> steps = flattenRegex(regex);
+
+    RegexComplexity result;
+    result.sharedChar = 0;
+
+    for(int c = 0; c < 256; c++)
+    {
+        vector<int> chain;
+        for(int i = 0; i < (int) steps.size(); i++)
+        {
+            const RegexStep &step = steps[i];
+            if(step.chars[c])
+            {
+                if(step.maxRepeat == -1)
+                {
+                    chain.push_back(i);
+                    if(chain.size() > result.ambiguousSteps.size())
+                    {
+                        result.ambiguousSteps = chain;
+                        result.sharedChar = (char) c;
+                    }
+                }
+            }
+            else if(step.minRepeat > 0)
+            {
+                chain.clear();
+            }
+        }
+    }
+
+    result.degree = result.ambiguousSteps.size() + 1;
+    return result;
+}
@@ -0,0 +1,52 @@
+#ifndef REGEX_ANALYSIS_HH
+#define REGEX_ANALYSIS_HH
+
+#include "regex.hh"
+
+
+/* A static estimate of how badly the backtracking engine can behave on a
+ * regex, worked out from the pattern alone.
+ *
+ * These regexes have no nesting or alternation, so backtracking is never
+ * exponential; the danger is a chain of unbounded repeats that can trade
+ * characters with one another, like "a*a*" or ".*x.*".  On a run of a
+ * character that every repeat in the chain accepts, the engine tries every
+ * way of splitting the run between them before it gives up, and it does
+ * that from every start index.  With k such repeats the worst case is
+ * therefore about n^(k + 1) steps for an input of length n.
+ */
+struct RegexComplexity {
+    // The worst-case number of steps grows as n^degree.  A regex with no
+    // unbounded repeats has degree 1.
+    int degree;
+
+    // The longest chain of repeats that can trade characters, as indexes
+    // into flattenRegex(), and a character they all accept.
+    vector<int> ambiguousSteps;
+    char sharedChar;
+};
+
+RegexComplexity analyzeRegex(const vector<RegexOperator *> &regex);
+
+
+/* What to do with a pattern whose degree is above a policy's limit.  ALLOW
+ * ignores the limit, REJECT refuses to compile the pattern, and
+ * FORCE_LINEAR compiles it but never lets the backtracking engine search
+ * with it, failing instead if no linear-time engine can take it.
+ */
+enum class ComplexityAction {
+    ALLOW, FORCE_LINEAR, REJECT
+};
+
+struct ComplexityPolicy {
+    int maxDegree;
+    ComplexityAction action;
+
+    // By default, patterns are always allowed, as before.
+    ComplexityPolicy(int maxDegree = 2,
+                     ComplexityAction action = ComplexityAction::ALLOW)
+        : maxDegree(maxDegree), action(action) { }
+};
+
+
+#endif // REGEX_ANALYSIS_HH
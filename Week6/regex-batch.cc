@@ -0,0 +1,100 @@
+#include "regex-batch.hh"
+#include "engine.hh"
+
+#include <algorithm>
+
+
+/* Parses every pattern, and builds the Aho-Corasick automaton if they all
+ * turn out to be literals, or a searcher for each literal otherwise.
+ */
+RegexBatch::RegexBatch(const vector<string> &patterns, int flags) {
+    literals = nullptr;
+
+    vector<string> texts;
+    bool allLiteral = true;
+    for (const string &p : patterns) {
+        regexes.push_back(parseRegex(p, flags));
+
+        string text;
+        if (getLiteral(regexes.back(), text) && !text.empty()) {
+            texts.push_back(text);
+            searchers.push_back(new LiteralSearcher(text));
+        }
+        else {
+            allLiteral = false;
+            searchers.push_back(nullptr);
+        }
+    }
+
+    if (allLiteral && !patterns.empty())
+        literals = new AhoCorasick(texts);
+}
+
+RegexBatch::~RegexBatch() {
+    delete literals;
+    for (LiteralSearcher *searcher : searchers)
+        delete searcher;
+    for (const vector<RegexOperator *> &regex : regexes)
+        clearRegex(regex);
+}
+
+
+int RegexBatch::numPatterns() const {
+    return regexes.size();
+}
+
+bool RegexBatch::usesAhoCorasick() const {
+    return literals != nullptr;
+}
+
+
+/* Orders hits by end index, then by pattern index. */
+static bool hitBefore(const PatternHit &a, const PatternHit &b) {
+    if (a.range.end != b.range.end)
+        return a.range.end < b.range.end;
+    return a.pattern < b.pattern;
+}
+
+
+/* Returns, for every pattern, a hit at every index where the pattern matches
+ * (with the match the engine would report there), ordered by end index and
+ * then by pattern index.
+ */
+vector<PatternHit> RegexBatch::findAll(const string &s) const {
+    vector<PatternHit> hits;
+
+    if (literals != nullptr) {
+        literals->findAll(s, hits);
+        return hits;
+    }
+
+    int len = s.length();
+    EngineStats stats;
+    for (int p = 0; p < (int) regexes.size(); p++) {
+        // A literal matches at exactly the indexes where it occurs.
+        if (searchers[p] != nullptr) {
+            int m = searchers[p]->length();
+            for (int i = searchers[p]->find(s); i != -1;
+                 i = searchers[p]->find(s, i + 1)) {
+                PatternHit hit;
+                hit.pattern = p;
+                hit.range = Range(i, i + m);
+                hits.push_back(hit);
+            }
+            continue;
+        }
+
+        for (int i = 0; i < len; i++) {
+            Range r = findAtIndex(regexes[p], s, i, stats);
+            if (r.start != -1) {
+                PatternHit hit;
+                hit.pattern = p;
+                hit.range = r;
+                hits.push_back(hit);
+            }
+        }
+    }
+
+    stable_sort(hits.begin(), hits.end(), hitBefore);
+    return hits;
+}
@@ -0,0 +1,40 @@
+#ifndef REGEX_BATCH_HH
+#define REGEX_BATCH_HH
+
+#include "aho-corasick.hh"
+#include "literal.hh"
+
+
+/* A set of patterns that are searched for together.
+ *
+ * When every pattern is a plain literal, the batch is searched with a single
+ * Aho-Corasick automaton in one linear pass over the input, no matter how
+ * many patterns there are.  Otherwise each pattern is searched in turn:  the
+ * literal ones with a LiteralSearcher built when the batch is, and the rest
+ * with the backtracking engine.  Both paths report the same hits.
+ */
+class RegexBatch {
+    vector<vector<RegexOperator *>> regexes;
+
+    // Non-null when every pattern is a non-empty literal.
+    AhoCorasick *literals;
+
+    // For each pattern, a searcher if it is a non-empty literal, or null.
+    vector<LiteralSearcher *> searchers;
+
+    // Not copyable, since the batch owns its operators.
+    RegexBatch(const RegexBatch &);
+    RegexBatch & operator=(const RegexBatch &);
+
+public:
+    RegexBatch(const vector<string> &patterns, int flags = 0);
+    ~RegexBatch();
+
+    int numPatterns() const;
+    bool usesAhoCorasick() const;
+
+    vector<PatternHit> findAll(const string &s) const;
+};
+
+
+#endif // REGEX_BATCH_HH
@@ -0,0 +1,73 @@
+#include "dfa-file.hh"
+
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+
+/* This program compiles a set of patterns ahead of time into a DFA file, which
+ * matchers can then map at startup instead of parsing every pattern.  The
+ * patterns are read one per line from the input file.
+ */
+
+
+/*! Prints a usage statement for the program. */
+void printUsage(char *name)
+{
+    cerr << "Usage: " << name << " PATTERN-FILE OUTPUT-FILE" << endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc != 3)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    ifstream in(argv[1]);
+    if(!in)
+    {
+        cerr << "Could not open " << argv[1] << endl;
+        return 1;
+    }
+
+    vector<string> patterns;
+    string line;
+    while(getline(in, line))
+    {
+        patterns.push_back(line);
+    }
+
+    string error;
+    if(!writeDFAFile(argv[2], patterns, error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+
+    // Load the file back, so a bad file is caught here rather than at the
+    // startup of every matcher.
+    DFAFile file;
+    if(!file.open(argv[2], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+
+    int totalStates = 0;
+    long tableEntries = 0;
+    for(int i = 0; i < file.numPatterns(); i++)
+    {
+        const DFA &dfa = file.getDFA(i);
+        totalStates += dfa.getNumStates();
+        tableEntries += (long) dfa.getNumStates() * dfa.getNumClasses();
+    }
+
+    cout << "Compiled " << file.numPatterns() << " patterns (" << totalStates
+         << " DFA states, " << tableEntries << " transitions) into "
+         << argv[2] << endl;
+    return 0;
+}
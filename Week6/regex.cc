@@ -1,4 +1,5 @@
 #include "regex.hh"
+#include <cstring>
 #include <iostream>
 #include <vector>
 using namespace std;
@@ -64,6 +65,11 @@ int RegexOperator::numMatches() const {
     return (int) matches.size();
 }
 
+/* Returns the last match the operator successfully matched against. */
+Range RegexOperator::lastMatch() const {
+    return matches.back();
+}
+
 /* Removes the last match the operator successfully matched against.  Used for
  * backtracking by the regex engine.
  */
@@ -73,104 +79,257 @@ Range RegexOperator::popMatch() {
     return r;
 }
 
-MatchChar::MatchChar(char s) : RegexOperator(Type::MATCH_CHAR) {
+/* Removes the last n matches at once, and returns the earliest of them.
+ * Used by the regex engine to backtrack several steps in one go.
+ */
+Range RegexOperator::popMatches(int n) {
+    assert(n >= 1 && n <= (int) matches.size());
+    Range r = matches[matches.size() - n];
+    matches.resize(matches.size() - n);
+    return r;
+}
+
+/* If each match of the operator consumes one fixed sequence of bytes, stores
+ * it in text and returns true.  Operators accept more than one sequence
+ * unless they say otherwise.
+ */
+bool RegexOperator::getLiteralText(string &) const {
+    return false;
+}
+
+/* Returns the other-case version of c, or c itself if it is not a letter. */
+static char otherCase(char c)
+{
+    if(c >= 'a' && c <= 'z')
+    {
+        return c - 'a' + 'A';
+    }
+    if(c >= 'A' && c <= 'Z')
+    {
+        return c - 'A' + 'a';
+    }
+    return c;
+}
+
+/* Builds the 256-entry membership bitmap for a bracket class.  When foldCase
+ * is set, both cases of every letter in the class are members.
+ */
+static bitset<256> classBitmap(const string &s, bool foldCase)
+{
+    bitset<256> members;
+    for(char c : s)
+    {
+        members[(unsigned char) c] = true;
+        if(foldCase)
+        {
+            members[(unsigned char) otherCase(c)] = true;
+        }
+    }
+    return members;
+}
+
+/* A MatchChar compiled with foldCase set accepts both cases of a letter, so
+ * that matching never needs a lowercased copy of the input.
+ */
+MatchChar::MatchChar(char s, bool foldCase) : RegexOperator(Type::MATCH_CHAR) {
     to_match = s;
+    alt_match = foldCase ? otherCase(s) : s;
 }
 
 bool MatchChar::match(const string &s, Range &r) const
 {
-    printf("In matchChar match\n");
     int sLen = s.length();
     if(r.start >= sLen)
     {
         return false;
     }
 
-    if(to_match == s[r.start])
+    if(to_match == s[r.start] || alt_match == s[r.start])
     {
-        printf("Found CharMatch\n");
         r.end = r.start + 1;
         return true; 
     }
-    printf("Found CharMismatch\n");
     return false;
 }
 
+bool MatchChar::matchesChar(char c) const
+{
+    return c == to_match || c == alt_match;
+}
+
+bool MatchChar::getLiteralText(string &text) const
+{
+    text = string(1, to_match);
+    return to_match == alt_match;
+}
+
+MatchString::MatchString(const string &s) : RegexOperator(Type::MATCH_STRING)
+{
+    assert(!s.empty());
+    text = s;
+}
+
+bool MatchString::match(const string &s, Range &r) const
+{
+    int sLen = s.length();
+    int tLen = text.length();
+    if(r.start > sLen - tLen)
+    {
+        return false;
+    }
+
+    if(memcmp(s.data() + r.start, text.data(), tLen) == 0)
+    {
+        r.end = r.start + tLen;
+        return true;
+    }
+    return false;
+}
+
+/* Only the first byte can be checked on its own; flattenRegex() expands the
+ * run into one step per byte.
+ */
+bool MatchString::matchesChar(char c) const
+{
+    return c == text[0];
+}
+
+bool MatchString::getLiteralText(string &text) const
+{
+    text = this->text;
+    return true;
+}
+
 MatchAny::MatchAny() : RegexOperator(Type::MATCH_ANY) {
 
 }
 
 bool MatchAny::match(const string &s, Range &r) const
 {
-    printf("In matchAny match\n");
     int sLen = s.length();
     if(r.start >= sLen)
     {
         return false;
     }
-    printf("Found AnyMatch\n");
     r.end = r.start + 1;
     return true;
 }
 
-MatchFromSubset::MatchFromSubset(string &s) : RegexOperator(Type::MATCH_SUBSET)
+bool MatchAny::matchesChar(char) const
 {
-    subset = s;
+    return true;
+}
+
+MatchFromSubset::MatchFromSubset(string &s, bool foldCase)
+    : RegexOperator(Type::MATCH_SUBSET)
+{
+    members = classBitmap(s, foldCase);
 }
 
 bool MatchFromSubset::match(const string &s, Range &r) const
 {
-    printf("In SubsetMatch match\n");
     int sLen = s.length();
-    int subLen = subset.length();
     if(r.start >= sLen)
     {
         return false;
     }
 
-    for(int i = 0; i < subLen; i++)
+    if(members[(unsigned char) s[r.start]])
     {
-        if(subset[i] == s[r.start])
-        {
-            printf("Found SubsetMatch\n");
-            r.end = r.start + 1;
-            return true;
-        }
-    }   
-    printf("Found SubsetMismatch\n");
+        r.end = r.start + 1;
+        return true;
+    }
     return false;
 }
 
-ExcludeFromSubset::ExcludeFromSubset(string &s) : RegexOperator(Type::EXCLUDE_SUBSET)
+bool MatchFromSubset::matchesChar(char c) const
+{
+    return members[(unsigned char) c];
+}
+
+ExcludeFromSubset::ExcludeFromSubset(string &s, bool foldCase)
+    : RegexOperator(Type::EXCLUDE_SUBSET)
 {
-    subset = s;
+    excluded = classBitmap(s, foldCase);
 }
 
 bool ExcludeFromSubset::match(const string &s, Range &r) const
 {
-    printf("In ExcludedMatch match\n");
     int sLen = s.length();
-    int subLen = subset.length();
     if(r.start >= sLen)
     {
         return false;
     }
 
-    for(int i = 0; i < subLen; i++)
+    if(excluded[(unsigned char) s[r.start]])
     {
-        if(subset[i] == s[r.start])
-        {
-            printf("Found Match in Excluded - Bad\n");
-            return false;
-        }
-    }   
-    printf("Found none from Excluded - Good\n");
+        return false;
+    }
     r.end = r.start + 1;
     return true;
 }
 
-vector<RegexOperator *> parseRegex(const string &expr)
+bool ExcludeFromSubset::matchesChar(char c) const
+{
+    return !excluded[(unsigned char) c];
+}
+
+/* Replaces every run of two or more unrepeated, exact MatchChars with a
+ * single MatchString.
+ */
+static void fuseLiteralRuns(vector<RegexOperator *> &regex)
+{
+    vector<RegexOperator *> fused;
+    string run;
+    int runStart = 0;
+
+    int numOps = regex.size();
+    for(int i = 0; i <= numOps; i++)
+    {
+        string text;
+        if(i < numOps &&
+           regex[i]->getType() == RegexOperator::Type::MATCH_CHAR &&
+           regex[i]->getMinRepeat() == 1 && regex[i]->getMaxRepeat() == 1 &&
+           regex[i]->getLiteralText(text))
+        {
+            if(run.empty())
+            {
+                runStart = i;
+            }
+            run += text;
+            continue;
+        }
+
+        if(run.length() >= 2)
+        {
+            for(int j = runStart; j < i; j++)
+            {
+                delete regex[j];
+            }
+            fused.push_back(new MatchString(run));
+        }
+        else if(run.length() == 1)
+        {
+            fused.push_back(regex[runStart]);
+        }
+        run.clear();
+
+        if(i < numOps)
+        {
+            fused.push_back(regex[i]);
+        }
+    }
+
+    regex.swap(fused);
+}
+
+/* Parses expr into a sequence of regex operators.  flags is a combination of
+ * the REGEX_* values; with REGEX_CASE_INSENSITIVE, case is folded into the
+ * operators themselves as they are built.
+ */
+vector<RegexOperator *> parseRegex(const string &expr, int flags)
 {
+    bool foldCase = (flags & REGEX_CASE_INSENSITIVE) != 0;
     int sLen = expr.length();
     vector<RegexOperator *> result;
     bool escape = 0; //0 if not being escaped, 1 if being escaped
@@ -187,8 +346,7 @@ vector<RegexOperator *> parseRegex(const string &expr)
                 if(escape == 0)
                 {
                     escape = 1;
-                    MatchChar op1 = MatchChar('\\');
-                    result.push_back(&op1);
+                    result.push_back(new MatchChar('\\'));
                 }
                 else
                 {
@@ -200,16 +358,15 @@ vector<RegexOperator *> parseRegex(const string &expr)
             {
                 if(escape == 0)
                 {
-                    MatchAny op1 = MatchAny();
-                    result.push_back(&op1);
+                    result.push_back(new MatchAny());
                 }
                 else
                 {
                     escape = 0;
+                    delete result.back();
                     result.pop_back();
 
-                    MatchChar op1 = MatchChar('.');
-                    result.push_back(&op1);
+                    result.push_back(new MatchChar('.'));
                 }
             }
 
@@ -222,10 +379,10 @@ vector<RegexOperator *> parseRegex(const string &expr)
                 else
                 {
                     escape = 0;
+                    delete result.back();
                     result.pop_back();
 
-                    MatchChar op1 = MatchChar('?');
-                    result.push_back(&op1);
+                    result.push_back(new MatchChar('?'));
                 }
             }
 
@@ -239,10 +396,10 @@ vector<RegexOperator *> parseRegex(const string &expr)
                 else
                 {
                     escape = 0;
+                    delete result.back();
                     result.pop_back();
 
-                    MatchChar op1 = MatchChar('*');
-                    result.push_back(&op1);
+                    result.push_back(new MatchChar('*'));
                 }
             }
 
@@ -255,10 +412,10 @@ vector<RegexOperator *> parseRegex(const string &expr)
                 else
                 {
                     escape = 0;
+                    delete result.back();
                     result.pop_back();
 
-                    MatchChar op1 = MatchChar('+');
-                    result.push_back(&op1);
+                    result.push_back(new MatchChar('+'));
                 }
             }
 
@@ -270,8 +427,7 @@ vector<RegexOperator *> parseRegex(const string &expr)
             else
             {
                 escape = 0;
-                MatchChar op1 = MatchChar(expr[i]);
-                result.push_back(&op1);
+                result.push_back(new MatchChar(expr[i], foldCase));
             }
 
         }
@@ -283,13 +439,11 @@ vector<RegexOperator *> parseRegex(const string &expr)
                 if(negateBracket == 1)
                 {
                     negateBracket = 0;
-                    ExcludeFromSubset op1 = ExcludeFromSubset(inBracket);
-                    result.push_back(&op1);
+                    result.push_back(new ExcludeFromSubset(inBracket, foldCase));
                 }
                 else
                 {
-                    MatchFromSubset op1 = MatchFromSubset(inBracket);
-                    result.push_back(&op1);
+                    result.push_back(new MatchFromSubset(inBracket, foldCase));
                 }
 
                 bracket = 0;
@@ -306,6 +460,7 @@ vector<RegexOperator *> parseRegex(const string &expr)
         }
     }
 
+    fuseLiteralRuns(result);
     return result;
 }
 
@@ -313,12 +468,65 @@ void clearRegex(vector<RegexOperator *> regex)
 {
     while(regex.size() > 0)
     {
+        delete regex.back();
         regex.pop_back();
     }
 }
 
 
+/* Converts a parsed regex into one RegexStep per operator, by asking each
+ * operator which of the 256 byte values it accepts.  A MatchString becomes
+ * one step per byte, so the steps never depend on whether runs were fused.
+ */
+vector<RegexStep> flattenRegex(const vector<RegexOperator *> &regex)
+{
+    vector<RegexStep> steps;
+    for(RegexOperator *op : regex)
+    {
+        string text;
+        if(op->getType() == RegexOperator::Type::MATCH_STRING &&
+           op->getLiteralText(text))
+        {
+            for(char c : text)
+            {
+                RegexStep step;
+                step.chars[(unsigned char) c] = true;
+                step.minRepeat = 1;
+                step.maxRepeat = 1;
+                steps.push_back(step);
+            }
+            continue;
+        }
 
+        RegexStep step;
+        for(int c = 0; c < 256; c++)
+        {
+            step.chars[c] = op->matchesChar((char) c);
+        }
+        step.minRepeat = op->getMinRepeat();
+        step.maxRepeat = op->getMaxRepeat();
+        steps.push_back(step);
+    }
+    return steps;
+}
 
 
-
+/* Returns true if the regex is a plain literal:  every operator accepts
+ * exactly one sequence of bytes, exactly once.  The literal's text is stored
+ * in literal.  This is cheap enough to check on every search.
+ */
+bool getLiteral(const vector<RegexOperator *> &regex, string &literal)
+{
+    literal.clear();
+    for(RegexOperator *op : regex)
+    {
+        string text;
+        if(op->getMinRepeat() != 1 || op->getMaxRepeat() != 1 ||
+           !op->getLiteralText(text))
+        {
+            return false;
+        }
+        literal += text;
+    }
+    return true;
+}
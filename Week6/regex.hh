@@ -1,3 +1,8 @@
+#ifndef REGEX_HH
+#define REGEX_HH
+
+
+#include <bitset>
 #include <cassert>
 #include <string>
 #include <vector>
@@ -62,7 +67,7 @@ class RegexOperator {
 public:
 
     enum class Type {
-        MATCH_CHAR, MATCH_ANY, MATCH_SUBSET, EXCLUDE_SUBSET
+        MATCH_CHAR, MATCH_ANY, MATCH_SUBSET, EXCLUDE_SUBSET, MATCH_STRING
     };
 
 private:
@@ -75,6 +80,8 @@ public:
     RegexOperator::Type getType() const;
 
     virtual bool match(const string &s, Range &r) const = 0;
+    virtual bool matchesChar(char c) const = 0;
+    virtual bool getLiteralText(string &text) const;
     virtual ~RegexOperator() { };
 
     // Operations to support optional and repeat operations.
@@ -87,49 +94,89 @@ public:
     void clearMatches();
     void pushMatch(const Range &r);
     int numMatches() const;
+    Range lastMatch() const;
     Range popMatch();
+    Range popMatches(int n);
 
 
 };
 
 
-vector<RegexOperator *> parseRegex(const string &expr);
+// Flags that change how parseRegex() compiles a pattern.
+const int REGEX_CASE_INSENSITIVE = 1;
+
+vector<RegexOperator *> parseRegex(const string &expr, int flags = 0);
 void clearRegex(vector<RegexOperator *> regex);
 
 
+/* A flattened view of one operator in a regex:  the set of bytes it accepts,
+ * and its repeat bounds.  The automaton-based engines are built from these
+ * rather than from the operator objects directly.
+ */
+struct RegexStep {
+    bitset<256> chars;
+    int minRepeat;
+    int maxRepeat;
+};
+
+vector<RegexStep> flattenRegex(const vector<RegexOperator *> &regex);
+bool getLiteral(const vector<RegexOperator *> &regex, string &literal);
+
+
 class MatchChar : public RegexOperator {
     char to_match;
+    char alt_match;     // the other case when folding case, else to_match
     public:
-        MatchChar(char s);
+        MatchChar(char s, bool foldCase = false);
         bool match(const string &s, Range &r) const;
+        bool matchesChar(char c) const;
+        bool getLiteralText(string &text) const;
         virtual ~MatchChar() { };
 };
 
+/* A run of plain characters, matched with one comparison.  parseRegex()
+ * fuses consecutive unrepeated MatchChars into one of these, so the engine
+ * makes one call and records one match for the whole run.
+ */
+class MatchString : public RegexOperator {
+    string text;
+    public:
+        MatchString(const string &s);
+        bool match(const string &s, Range &r) const;
+        bool matchesChar(char c) const;
+        bool getLiteralText(string &text) const;
+        virtual ~MatchString() { };
+};
+
 class MatchAny : public RegexOperator {
     public:
         MatchAny();
         bool match(const string &s, Range &r) const;
+        bool matchesChar(char c) const;
         virtual ~MatchAny() { };
 };
 
 class MatchFromSubset : public RegexOperator {
     private:
-        string subset;
+        bitset<256> members;
 
     public:
-        MatchFromSubset(string &s);
+        MatchFromSubset(string &s, bool foldCase = false);
         bool match(const string &s, Range &r) const;
+        bool matchesChar(char c) const;
         virtual ~MatchFromSubset() { };
 };
 
 class ExcludeFromSubset : public RegexOperator {
     private:
-        string subset;
+        bitset<256> excluded;
 
     public:
-        ExcludeFromSubset(string &s);
+        ExcludeFromSubset(string &s, bool foldCase = false);
         bool match(const string &s, Range &r) const;
+        bool matchesChar(char c) const;
         virtual ~ExcludeFromSubset() { };
 };
 
 
+#endif // REGEX_HH
@@ -0,0 +1,88 @@
+#include "shift-and.hh"
+
+
+/* Picks the narrowest engine that can hold the regex. */
+ShiftAnd::ShiftAnd(const vector<RegexOperator *> &regex) {
+    narrow = nullptr;
+    wide = nullptr;
+    narrowReversed = nullptr;
+    wideReversed = nullptr;
+
+    vector<RegexStep> steps = flattenRegex(regex);
+    for (const RegexStep &step : steps) {
+        if (step.minRepeat > 1 ||
+            (step.maxRepeat != 1 && step.maxRepeat != -1))
+            return;
+    }
+
+    vector<RegexStep> reversed(steps.rbegin(), steps.rend());
+    if (steps.size() <= MAX_NARROW_STEPS) {
+        narrow = new ShiftAndEngine<1>(steps);
+        narrowReversed = new ShiftAndEngine<1>(reversed);
+    }
+    else if (steps.size() <= MAX_STEPS) {
+        wide = new ShiftAndEngine<4>(steps);
+        wideReversed = new ShiftAndEngine<4>(reversed);
+    }
+}
+
+ShiftAnd::~ShiftAnd() {
+    delete narrow;
+    delete wide;
+    delete narrowReversed;
+    delete wideReversed;
+}
+
+
+bool ShiftAnd::ok() const {
+    return narrow != nullptr || wide != nullptr;
+}
+
+
+int ShiftAnd::longestAt(const string &s, int start) const {
+    if (narrow != nullptr)
+        return narrow->longestAt(s, start);
+    return wide->longestAt(s, start);
+}
+
+
+/* Finds the leftmost, longest match starting at or after index from, in the
+ * same way as the DFA engine:  one unanchored pass finds where the
+ * earliest-ending match ends, the reversed engine reads backward from there
+ * to the leftmost start, and one anchored pass extends the match from it.
+ * Each pass is linear in the bytes it reads.
+ */
+Range ShiftAnd::find(const string &s, int from) const {
+    assert(ok());
+
+    int len = s.length();
+    if (from >= len)
+        return Range(-1, -1);
+
+    int end = narrow != nullptr ? narrow->firstEnd(s, from) :
+        wide->firstEnd(s, from);
+    if (end == -1)
+        return Range(-1, -1);
+
+    int start = narrow != nullptr ?
+        narrowReversed->earliestStart(s, from, end) :
+        wideReversed->earliestStart(s, from, end);
+
+    // Like the backtracking engine, never report a match starting at the
+    // very end of the string.
+    if (start == -1 || start >= len)
+        return Range(-1, -1);
+
+    return Range(start, longestAt(s, start));
+}
+
+
+/* Returns true if the regex matches all of s. */
+bool ShiftAnd::match(const string &s) const {
+    assert(ok());
+
+    if (s.empty())
+        return false;
+
+    return longestAt(s, 0) == (int) s.length();
+}
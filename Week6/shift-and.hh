@@ -0,0 +1,287 @@
+#ifndef SHIFT_AND_HH
+#define SHIFT_AND_HH
+
+#include "regex.hh"
+
+#include <cstdint>
+
+
+/* A set of WORDS * 64 bits, with the few operations the bit-parallel matcher
+ * needs.  The bitwise operations are independent per word, so the compiler
+ * can keep a multi-word mask in one SIMD register; only the shift and the
+ * subtraction carry from word to word.
+ */
+template <int WORDS>
+struct WordMask {
+    uint64_t w[WORDS];
+
+    void clear() {
+        for (int i = 0; i < WORDS; i++)
+            w[i] = 0;
+    }
+
+    void set(int bit) {
+        w[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+
+    bool any() const {
+        uint64_t x = 0;
+        for (int i = 0; i < WORDS; i++)
+            x |= w[i];
+        return x != 0;
+    }
+
+    WordMask operator&(const WordMask &m) const {
+        WordMask r;
+        for (int i = 0; i < WORDS; i++)
+            r.w[i] = w[i] & m.w[i];
+        return r;
+    }
+
+    WordMask operator|(const WordMask &m) const {
+        WordMask r;
+        for (int i = 0; i < WORDS; i++)
+            r.w[i] = w[i] | m.w[i];
+        return r;
+    }
+
+    WordMask operator^(const WordMask &m) const {
+        WordMask r;
+        for (int i = 0; i < WORDS; i++)
+            r.w[i] = w[i] ^ m.w[i];
+        return r;
+    }
+
+    WordMask operator~() const {
+        WordMask r;
+        for (int i = 0; i < WORDS; i++)
+            r.w[i] = ~w[i];
+        return r;
+    }
+
+    // Shifts every bit up by one place.
+    WordMask shifted() const {
+        WordMask r;
+        uint64_t carry = 0;
+        for (int i = 0; i < WORDS; i++) {
+            r.w[i] = (w[i] << 1) | carry;
+            carry = w[i] >> 63;
+        }
+        return r;
+    }
+
+    WordMask operator-(const WordMask &m) const {
+        WordMask r;
+        uint64_t borrow = 0;
+        for (int i = 0; i < WORDS; i++) {
+            r.w[i] = w[i] - m.w[i] - borrow;
+            borrow = (w[i] < m.w[i]) || (w[i] - m.w[i] < borrow);
+        }
+        return r;
+    }
+};
+
+
+/* A bit-parallel (Shift-And) simulation of the regex's position automaton,
+ * for regexes of at most WORDS * 64 operators.
+ *
+ * Bit j of the state is set when operator j has just consumed the last input
+ * character.  To advance over a character c, the set of operators that are
+ * "ready" to consume the next character is computed from the state with a
+ * shift (move on to the next operator), a mask (repeatable operators can go
+ * again) and a carry trick that lets readiness flow through runs of optional
+ * operators in one step; the new state is that set ANDed with the operators
+ * that accept c.  Each input byte costs a handful of word operations, no
+ * matter how the regex is built, and no automaton has to be constructed.
+ */
+template <int WORDS>
+class ShiftAndEngine {
+public:
+    typedef WordMask<WORDS> Mask;
+
+private:
+    // The operators that accept each byte.
+    Mask accepts[256];
+
+    Mask repeatable;    // operators with no upper repeat limit
+    Mask optional;      // operators that may be skipped
+    Mask runFirst;      // first operator of each run of optional operators
+    Mask runLast;       // last operator of each run of optional operators
+    Mask final;         // operators after which the regex may end
+    Mask first;         // just operator 0
+
+    bool matchesEmpty;
+
+public:
+    ShiftAndEngine(const vector<RegexStep> &steps) {
+        int n = steps.size();
+        assert(n <= WORDS * 64);
+
+        for (int c = 0; c < 256; c++)
+            accepts[c].clear();
+        repeatable.clear();
+        optional.clear();
+        runFirst.clear();
+        runLast.clear();
+        final.clear();
+        first.clear();
+        if (n > 0)
+            first.set(0);
+
+        for (int j = 0; j < n; j++) {
+            for (int c = 0; c < 256; c++) {
+                if (steps[j].chars[c])
+                    accepts[c].set(j);
+            }
+
+            if (steps[j].maxRepeat == -1)
+                repeatable.set(j);
+
+            if (steps[j].minRepeat == 0) {
+                optional.set(j);
+                if (j == 0 || steps[j - 1].minRepeat != 0)
+                    runFirst.set(j);
+                if (j == n - 1 || steps[j + 1].minRepeat != 0)
+                    runLast.set(j);
+            }
+        }
+
+        // The regex may end after operator j if everything after it is
+        // optional.
+        matchesEmpty = true;
+        for (int j = n - 1; j >= 0; j--) {
+            if (matchesEmpty)
+                final.set(j);
+            if (steps[j].minRepeat != 0)
+                matchesEmpty = false;
+        }
+    }
+
+    /* Returns the operators ready to consume the next character, given the
+     * operators that consumed the last one.  If restart is set, the regex
+     * may also begin again at operator 0.
+     */
+    Mask ready(const Mask &state, bool restart) const {
+        Mask r = state.shifted() | (state & repeatable);
+        if (restart)
+            r = r | first;
+
+        // Readiness at an optional operator also readies every later
+        // operator in its run, and the operator just after the run.
+        Mask withLast = r | runLast;
+        r = r | (optional & (~(withLast - runFirst) ^ withLast));
+        r = r | (r & runLast).shifted();
+        return r;
+    }
+
+    // The operators that accept byte c.
+    const Mask & acceptsChar(unsigned char c) const {
+        return accepts[c];
+    }
+
+    // True if the regex may end in the given state.
+    bool isFinal(const Mask &state) const {
+        return (state & final).any();
+    }
+
+    bool matchesEmptyString() const {
+        return matchesEmpty;
+    }
+
+    /* Returns the end of the longest match starting at index start, or -1.
+     */
+    int longestAt(const string &s, int start) const {
+        int len = s.length();
+        int lastEnd = matchesEmpty ? start : -1;
+
+        Mask state;
+        state.clear();
+        for (int i = start; i < len; i++) {
+            state = ready(state, i == start) &
+                accepts[(unsigned char) s[i]];
+            if (!state.any())
+                break;
+            if ((state & final).any())
+                lastEnd = i + 1;
+        }
+
+        return lastEnd;
+    }
+
+    /* Returns the end of the earliest-ending match that starts at or after
+     * index from, or -1.
+     */
+    int firstEnd(const string &s, int from) const {
+        if (matchesEmpty)
+            return from;
+
+        int len = s.length();
+        Mask state;
+        state.clear();
+        for (int i = from; i < len; i++) {
+            state = ready(state, true) & accepts[(unsigned char) s[i]];
+            if ((state & final).any())
+                return i + 1;
+        }
+
+        return -1;
+    }
+
+    /* For an engine built from the steps in reverse order:  returns the
+     * smallest index at or after from at which a match of the original
+     * steps ending at index end starts, or -1.  The input is read backward
+     * from end.
+     */
+    int earliestStart(const string &s, int from, int end) const {
+        int start = matchesEmpty ? end : -1;
+
+        Mask state;
+        state.clear();
+        for (int i = end - 1; i >= from; i--) {
+            state = ready(state, i == end - 1) &
+                accepts[(unsigned char) s[i]];
+            if (!state.any())
+                break;
+            if ((state & final).any())
+                start = i;
+        }
+
+        return start;
+    }
+};
+
+
+/* Finds matches with a ShiftAndEngine one machine word wide when the regex
+ * has at most 64 operators, and four words wide when it has at most 256.
+ * Results are the same as the backtracking engine's.  A second engine of
+ * the same width, built from the regex backward, finds where a match starts
+ * from where it ends.
+ */
+class ShiftAnd {
+    ShiftAndEngine<1> *narrow;
+    ShiftAndEngine<4> *wide;
+    ShiftAndEngine<1> *narrowReversed;
+    ShiftAndEngine<4> *wideReversed;
+
+    // Not copyable, since the object owns its engine.
+    ShiftAnd(const ShiftAnd &);
+    ShiftAnd & operator=(const ShiftAnd &);
+
+    int longestAt(const string &s, int start) const;
+
+public:
+    static const int MAX_NARROW_STEPS = 64;
+    static const int MAX_STEPS = 256;
+
+    ShiftAnd(const vector<RegexOperator *> &regex);
+    ~ShiftAnd();
+
+    // False if the regex is too long, or uses unsupported repeat counts.
+    bool ok() const;
+
+    Range find(const string &s, int from = 0) const;
+    bool match(const string &s) const;
+};
+
+
+#endif // SHIFT_AND_HH
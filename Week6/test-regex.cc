@@ -1,14 +1,30 @@
 #include "testbase.hh"
 #include "engine.hh"
+#include "dfa-file.hh"
+#include "regex-batch.hh"
+#include "literal.hh"
+#include "compiled-regex.hh"
+#include "regex-analysis.hh"
+#include "shift-and.hh"
+#include "approx.hh"
+#include "trigram-index.hh"
 
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 
 using namespace std;
 
 
+// The time any one test may take.  Runaway backtracking is reported and
+// stops the run instead of hanging it.
+const long TEST_TIME_BUDGET_MS = 10000;
+
+
 /*===========================================================================
  * TEST FUNCTIONS
  *
@@ -448,12 +464,803 @@ void test_complex_regex(TestContext &ctx) {
 }
 
 
+/*! Test that backtracking into a wildcard run jumps straight to the next
+ *  literal instead of retrying every shorter run.
+ */
+void test_skip_ahead(TestContext &ctx) {
+    vector<RegexOperator *> regex = parseRegex("a.*cd");
+    string s = "xa" + string(10000, 'b') + "cd" + string(10000, 'b') + "e";
+    EngineStats stats;
+
+    ctx.DESC("Backtracking skips ahead to the next literal");
+
+    Range r = find(regex, s, stats);
+    ctx.CHECK(r.start == 1 && r.end == 10004);
+
+    // Matching the wildcard run takes one step per character; undoing it
+    // should take a handful more, not another one per character.
+    ctx.CHECK_AT_MOST((long) s.length() + 100, stats.steps);
+
+    r = find(regex, "acdcxcd");
+    ctx.CHECK(r.start == 0 && r.end == 7);
+
+    r = find(regex, "acdcx");
+    ctx.CHECK(r.start == 0 && r.end == 3);
+
+    r = find(regex, "abcbc");
+    ctx.CHECK(r.start == -1 && r.end == -1);
+
+    ctx.result();
+
+    clearRegex(regex);
+}
+
+
+/*! Test that runs of plain characters are fused into one operator. */
+void test_literal_runs(TestContext &ctx) {
+    ctx.DESC("Runs of plain characters are fused");
+
+    vector<RegexOperator *> regex = parseRegex("abcdef");
+    ctx.CHECK(regex.size() == 1);
+    ctx.CHECK(regex[0]->getType() == RegexOperator::Type::MATCH_STRING);
+    clearRegex(regex);
+
+    // Repeated characters and classes end a run; escaped characters do not.
+    regex = parseRegex("abc*de.fg\\.h[ij]k");
+    ctx.CHECK(regex.size() == 7);
+    ctx.CHECK(regex[0]->getType() == RegexOperator::Type::MATCH_STRING);
+    ctx.CHECK(regex[1]->getType() == RegexOperator::Type::MATCH_CHAR);
+    ctx.CHECK(regex[2]->getType() == RegexOperator::Type::MATCH_STRING);
+    ctx.CHECK(regex[3]->getType() == RegexOperator::Type::MATCH_ANY);
+    ctx.CHECK(regex[4]->getType() == RegexOperator::Type::MATCH_STRING);
+    ctx.CHECK(regex[5]->getType() == RegexOperator::Type::MATCH_SUBSET);
+    ctx.CHECK(find(regex, "xxabccde!fg.hjk").start == 2);
+    ctx.CHECK(find(regex, "xxabccde!fgzhjk").start == -1);
+    clearRegex(regex);
+
+    // Case-folded letters are not fused.
+    regex = parseRegex("ab", REGEX_CASE_INSENSITIVE);
+    ctx.CHECK(regex.size() == 2);
+    clearRegex(regex);
+
+    ctx.result();
+
+    ctx.DESC("Fused runs take one step per match attempt");
+
+    regex = parseRegex("needle.*haystack");
+    string s = string(100, 'x') + "needle" + string(100, 'x') + "haystack";
+    EngineStats stats;
+    Range r = find(regex, s, stats);
+    ctx.CHECK(r.start == 100 && r.end == (int) s.length());
+
+    // One step per start index for "needle", one per character for ".*",
+    // one for "haystack", and a few more for backtracking.
+    ctx.CHECK_AT_MOST(100 + 1 + 109 + 10, stats.steps);
+    clearRegex(regex);
+
+    ctx.result();
+}
+
+
+/*! Test case-insensitive compilation. */
+void test_case_insensitive(TestContext &ctx) {
+    vector<RegexOperator *> regex =
+        parseRegex("ab[cd]+[^xy]", REGEX_CASE_INSENSITIVE);
+    Range r;
+
+    ctx.DESC("Case-insensitive regex with find()");
+
+    r = find(regex, "abcz");
+    ctx.CHECK(r.start == 0 && r.end == 4);
+
+    r = find(regex, "--ABCdCz");
+    ctx.CHECK(r.start == 2 && r.end == 8);
+
+    r = find(regex, "aBdX");
+    ctx.CHECK(r.start == -1 && r.end == -1);
+
+    r = find(regex, "aBdY ");
+    ctx.CHECK(r.start == -1 && r.end == -1);
+
+    ctx.result();
+
+    ctx.DESC("Case-insensitive regex with match()");
+
+    ctx.CHECK(match(regex, "ABCD1"));
+    ctx.CHECK(match(regex, "aBcDe"));
+    ctx.CHECK(!match(regex, "abcx"));
+    ctx.CHECK(!match(regex, "abc"));
+
+    ctx.result();
+
+    clearRegex(regex);
+
+    // Without the flag, case still matters.
+    regex = parseRegex("ab[cd]+[^xy]");
+
+    ctx.DESC("Case-sensitive regex is unchanged");
+
+    ctx.CHECK(match(regex, "abcz"));
+    ctx.CHECK(!match(regex, "ABCZ"));
+    ctx.CHECK(match(regex, "abcX"));
+
+    ctx.result();
+
+    clearRegex(regex);
+}
+
+
+/* Patterns and strings used to check the other engines against the
+ * backtracking engine.
+ */
+const char *ENGINE_PATTERNS[] = {
+    "abc", "a.c", "a[aegi]c", "a[^aegi]c", "ab*c", "ab+c", "ab?c",
+    "a*b+[cde]?[^fgh]*k+", ".*", "a?a?a?aaa", "[ab]*a[ab][ab]", "x*",
+    "b+b*b?"
+};
+
+const char *ENGINE_STRINGS[] = {
+    "", "a", "abc", "dabcd", "ac", "abbbbc", "aegic", "aaabegjkk",
+    "aaabbbbbbbbegjkkmmmm", "xxaba", "bbbb", "ababbabab", "aaa", "zzz"
+};
+
+
+/*! Test the DFA engine, and DFA files, against the backtracking engine. */
+void test_dfa(TestContext &ctx) {
+    vector<string> patterns;
+    for (const char *p : ENGINE_PATTERNS)
+        patterns.push_back(p);
+
+    ctx.DESC("DFA find() and match() agree with backtracking");
+
+    for (const string &p : patterns) {
+        vector<RegexOperator *> regex = parseRegex(p);
+        DFA dfa(regex);
+        ctx.CHECK(dfa.ok());
+
+        for (const char *s : ENGINE_STRINGS) {
+            Range expected = find(regex, s);
+            Range r = dfa.find(s);
+            ctx.CHECK(r.start == expected.start && r.end == expected.end);
+            ctx.CHECK(dfa.match(s) == match(regex, s));
+        }
+
+        clearRegex(regex);
+    }
+
+    ctx.result();
+
+    ctx.DESC("DFA tables are minimized and use byte classes");
+
+    vector<RegexOperator *> regex = parseRegex("abc");
+    DFA literal(regex);
+    ctx.CHECK(literal.getNumClasses() == 4);
+    clearRegex(regex);
+
+    regex = parseRegex("x*x*x*");
+    DFA redundant(regex);
+    clearRegex(regex);
+
+    regex = parseRegex("x*");
+    DFA simple(regex);
+    clearRegex(regex);
+
+    ctx.CHECK(redundant.getNumClasses() == 2);
+    ctx.CHECK(redundant.getNumStates() == simple.getNumStates());
+
+    ctx.result();
+
+    ctx.DESC("DFA file round trip");
+
+    string path = "test-regex.dfa";
+    string error;
+    ctx.CHECK(writeDFAFile(path, patterns, error));
+
+    DFAFile file;
+    ctx.CHECK(file.open(path, error));
+    ctx.CHECK(file.numPatterns() == (int) patterns.size());
+
+    for (int i = 0; i < file.numPatterns(); i++) {
+        ctx.CHECK(file.getPattern(i) == patterns[i]);
+
+        vector<RegexOperator *> regex = parseRegex(patterns[i]);
+        for (const char *s : ENGINE_STRINGS) {
+            Range expected = find(regex, s);
+            Range r = file.getDFA(i).find(s);
+            ctx.CHECK(r.start == expected.start && r.end == expected.end);
+        }
+        clearRegex(regex);
+    }
+
+    file.close();
+    remove(path.c_str());
+
+    ctx.result();
+
+    ctx.DESC("Parallel DFA search agrees with find()");
+
+    // Long enough to be split into several segments, with the only match
+    // straddling a segment boundary.
+    string big(4 * DFA::MIN_SEGMENT_LENGTH, 'x');
+    big.replace(2 * DFA::MIN_SEGMENT_LENGTH - 2, 5, "aabbc");
+
+    for (const string &p : patterns) {
+        vector<RegexOperator *> regex = parseRegex(p);
+        DFA dfa(regex);
+
+        Range expected = dfa.find(big);
+        Range r = dfa.parallelFind(big, 4);
+        ctx.CHECK(r.start == expected.start && r.end == expected.end);
+
+        for (const char *s : ENGINE_STRINGS) {
+            expected = dfa.find(s);
+            r = dfa.parallelFind(s, 4);
+            ctx.CHECK(r.start == expected.start && r.end == expected.end);
+        }
+
+        clearRegex(regex);
+    }
+
+    ctx.result();
+
+    ctx.DESC("DFA search stays linear when every start fails late");
+
+    // Every start before the 'a' runs up to it before failing, so trying
+    // each start in turn would take about n^2 / 2 steps.
+    vector<RegexOperator *> lateRegex = parseRegex("[^a]+[^a]+c+a*");
+    DFA late(lateRegex);
+    string s(2000000, 'b');
+    s += "abbc";
+    ctx.CHECK_WITHIN(500, late.find(s).start == (int) s.length() - 3);
+    ctx.CHECK(late.find(s).end == (int) s.length());
+    clearRegex(lateRegex);
+
+    ctx.result();
+}
+
+
+/*! Test the bit-parallel engine against the backtracking engine. */
+void test_shift_and(TestContext &ctx) {
+    ctx.DESC("Shift-And find() and match() agree with backtracking");
+
+    for (const char *p : ENGINE_PATTERNS) {
+        vector<RegexOperator *> regex = parseRegex(p);
+        ShiftAnd shiftAnd(regex);
+        ctx.CHECK(shiftAnd.ok());
+
+        for (const char *s : ENGINE_STRINGS) {
+            Range expected = find(regex, s);
+            Range r = shiftAnd.find(s);
+            ctx.CHECK(r.start == expected.start && r.end == expected.end);
+            ctx.CHECK(shiftAnd.match(s) == match(regex, s));
+        }
+
+        clearRegex(regex);
+    }
+
+    ctx.result();
+
+    ctx.DESC("Shift-And with more than 64 operators");
+
+    // 70 operators, so the four-word engine is used.
+    string pattern;
+    for (int i = 0; i < 10; i++)
+        pattern += "ab?c*[de]+";
+    vector<RegexOperator *> regex = parseRegex(pattern);
+    ShiftAnd shiftAnd(regex);
+    ctx.CHECK(shiftAnd.ok());
+
+    string s;
+    for (int i = 0; i < 10; i++)
+        s += "acccde";
+    Range expected = find(regex, "xx" + s + "xx");
+    Range r = shiftAnd.find("xx" + s + "xx");
+    ctx.CHECK(expected.start == 2 && expected.end == 62);
+    ctx.CHECK(r.start == expected.start && r.end == expected.end);
+    ctx.CHECK(shiftAnd.match(s));
+    ctx.CHECK(!shiftAnd.match(s + "a"));
+
+    clearRegex(regex);
+
+    ctx.result();
+
+    ctx.DESC("Shift-And search stays linear when every start fails late");
+
+    regex = parseRegex("[^a]+[^a]+c+a*");
+    ShiftAnd late(regex);
+    string big(2000000, 'b');
+    big += "abbc";
+    ctx.CHECK_WITHIN(500, late.find(big).start == (int) big.length() - 3);
+    ctx.CHECK(late.find(big).end == (int) big.length());
+    clearRegex(regex);
+
+    ctx.result();
+}
+
+
+/*! Test approximate matching with a bounded number of errors. */
+void test_approx(TestContext &ctx) {
+    ctx.DESC("Approximate distance() of whole strings");
+
+    vector<RegexOperator *> regex = parseRegex("hello");
+    ApproxMatcher oneError(regex, 1);
+    ApproxMatcher twoErrors(regex, 2);
+    ctx.CHECK(oneError.ok());
+    ctx.CHECK(oneError.distance("hello") == 0);
+    ctx.CHECK(oneError.distance("hallo") == 1);
+    ctx.CHECK(oneError.distance("helo") == 1);
+    ctx.CHECK(oneError.distance("helllo") == 1);
+    ctx.CHECK(oneError.distance("hxllx") == -1);
+    ctx.CHECK(twoErrors.distance("hxllx") == 2);
+    ctx.CHECK(twoErrors.distance("") == -1);
+    clearRegex(regex);
+
+    regex = parseRegex("ab*c");
+    ApproxMatcher repeats(regex, 1);
+    ctx.CHECK(repeats.distance("abbbbc") == 0);
+    ctx.CHECK(repeats.distance("abbxbc") == 1);
+    ctx.CHECK(repeats.distance("bbbc") == 1);
+    ctx.CHECK(repeats.distance("xabc") == 1);
+    ctx.CHECK(repeats.distance("abcx") == 1);
+    ctx.CHECK(repeats.distance("xabcx") == -1);
+    clearRegex(regex);
+
+    ctx.result();
+
+    ctx.DESC("Approximate findEnd() within a string");
+
+    regex = parseRegex("hello");
+    ApproxMatcher matcher(regex, 1);
+    int errors;
+    ctx.CHECK(matcher.findEnd("say helo there", errors) == 8);
+    ctx.CHECK(errors == 1);
+    ctx.CHECK(matcher.findEnd("hello", errors) == 4);
+    ctx.CHECK(errors == 1);
+    ctx.CHECK(matcher.findEnd("hxxlo", errors) == -1);
+    clearRegex(regex);
+
+    // Approximate matching with no errors allowed is ordinary matching (the
+    // other engines never report a match of the empty string).
+    for (const char *p : ENGINE_PATTERNS) {
+        regex = parseRegex(p);
+        ApproxMatcher exact(regex, 0);
+        ShiftAnd shiftAnd(regex);
+        for (const char *s : ENGINE_STRINGS) {
+            if (s[0] == '\0')
+                continue;
+            ctx.CHECK((exact.distance(s) == 0) == shiftAnd.match(s));
+            ctx.CHECK((exact.findEnd(s, errors) != -1) ==
+                      (shiftAnd.find(s).start != -1));
+        }
+        clearRegex(regex);
+    }
+
+    ctx.result();
+}
+
+
+/*! Test the trigram query planner, and index lookups on a small corpus. */
+void test_trigram_index(TestContext &ctx) {
+    ctx.DESC("Trigram query planning");
+
+    vector<RegexOperator *> regex = parseRegex("abcd");
+    TrigramQuery query = planTrigramQuery(regex);
+    ctx.CHECK(query.clauses.size() == 2);
+    ctx.CHECK(query.clauses[0] == vector<uint32_t>({ 0x616263 }));
+    ctx.CHECK(query.clauses[1] == vector<uint32_t>({ 0x626364 }));
+    clearRegex(regex);
+
+    // Optional operators split runs; a repeat ends one run and starts the
+    // next; wide classes are skipped.
+    regex = parseRegex("abx?cde+fg.hij");
+    query = planTrigramQuery(regex);
+    ctx.CHECK(query.clauses.size() == 3);
+    ctx.CHECK(query.clauses[0] == vector<uint32_t>({ 0x636465 }));
+    ctx.CHECK(query.clauses[1] == vector<uint32_t>({ 0x656667 }));
+    ctx.CHECK(query.clauses[2] == vector<uint32_t>({ 0x68696a }));
+    clearRegex(regex);
+
+    regex = parseRegex("ab[xy]", REGEX_CASE_INSENSITIVE);
+    query = planTrigramQuery(regex);
+    ctx.CHECK(query.clauses.size() == 1 && query.clauses[0].size() == 16);
+    clearRegex(regex);
+
+    regex = parseRegex("a.*b");
+    ctx.CHECK(planTrigramQuery(regex).matchesAll());
+    clearRegex(regex);
+
+    ctx.result();
+
+    ctx.DESC("Trigram index candidates");
+
+    const char *texts[] = {
+        "the quick brown fox", "jumps over", "the lazy dog", "", "ab",
+        "quick quick quick"
+    };
+    vector<string> docPaths;
+    for (int i = 0; i < 6; i++) {
+        docPaths.push_back("test-regex-doc" + to_string(i) + ".txt");
+        ofstream out(docPaths.back());
+        out << texts[i];
+    }
+
+    string path = "test-regex.tri";
+    string error;
+    ctx.CHECK(writeTrigramIndex(path, docPaths, error));
+
+    TrigramIndex index;
+    ctx.CHECK(index.open(path, error));
+    ctx.CHECK(index.numDocs() == 6);
+    ctx.CHECK(index.getDocPath(2) == docPaths[2]);
+    ctx.CHECK(index.getDocSize(0) == 19);
+    ctx.CHECK(index.countDocs(0x746865) == 2);    // "the"
+
+    // Every document that matches must be a candidate.
+    const char *patterns[] = {
+        "quick", "the", "o.er", "th[e]+ [lq]", "zzz", "a.*b", "ab", "u?mps"
+    };
+    for (const char *p : patterns) {
+        regex = parseRegex(p);
+        vector<int> docs;
+        index.candidates(planTrigramQuery(regex), docs);
+        for (int i = 0; i < 6; i++) {
+            if (find(regex, texts[i]).start != -1) {
+                ctx.CHECK(std::find(docs.begin(), docs.end(), i) !=
+                          docs.end());
+            }
+        }
+        clearRegex(regex);
+    }
+
+    regex = parseRegex("quick");
+    vector<int> docs;
+    index.candidates(planTrigramQuery(regex), docs);
+    ctx.CHECK(docs == vector<int>({ 0, 5 }));
+    clearRegex(regex);
+
+    regex = parseRegex("the [lq]");
+    index.candidates(planTrigramQuery(regex), docs);
+    ctx.CHECK(docs == vector<int>({ 0, 2 }));
+    clearRegex(regex);
+
+    regex = parseRegex("zzz");
+    index.candidates(planTrigramQuery(regex), docs);
+    ctx.CHECK(docs.empty());
+    clearRegex(regex);
+
+    index.close();
+    remove(path.c_str());
+    for (const string &p : docPaths)
+        remove(p.c_str());
+
+    ctx.result();
+}
+
+
+/*! Test that the compiled-regex front end routes calls sensibly, and gets
+ *  the same answers as the backtracking engine whichever engine it picks.
+ */
+void test_compiled_regex(TestContext &ctx) {
+    typedef CompiledRegex::Engine Engine;
+
+    ctx.DESC("Compiled regex agrees with backtracking");
+
+    for (const char *p : ENGINE_PATTERNS) {
+        CompiledRegex compiled(p);
+        vector<RegexOperator *> regex = parseRegex(p);
+
+        for (const char *s : ENGINE_STRINGS) {
+            Range expected = find(regex, s);
+            Range r = compiled.find(s);
+            ctx.CHECK(r.start == expected.start && r.end == expected.end);
+            ctx.CHECK(compiled.match(s) == match(regex, s));
+        }
+
+        clearRegex(regex);
+    }
+
+    ctx.result();
+
+    ctx.DESC("Compiled regex routing");
+
+    CompiledRegex literal("needle");
+    ctx.CHECK(literal.chooseEngine(10) == Engine::LITERAL);
+    literal.find("haystack");
+    ctx.CHECK(literal.getCalls(Engine::LITERAL) == 1);
+
+    CompiledRegex noRepeats("a.c");
+    ctx.CHECK(noRepeats.chooseEngine(10) == Engine::BACKTRACK);
+    ctx.CHECK(noRepeats.chooseEngine(10000) == Engine::DFA);
+
+    CompiledRegex repeats("a.*c");
+    ctx.CHECK(repeats.chooseEngine(10) == Engine::SHIFT_AND);
+    ctx.CHECK(repeats.chooseEngine(10000) == Engine::DFA);
+    repeats.find("abc");
+    repeats.match(string(100, 'a') + "c");
+    ctx.CHECK(repeats.getCalls(Engine::SHIFT_AND) == 1);
+    ctx.CHECK(repeats.getCalls(Engine::DFA) == 1);
+    ctx.CHECK(repeats.getCalls(Engine::BACKTRACK) == 0);
+
+    ctx.result();
+}
+
+
+/*! Test replaceAll() and split() against repeated find() calls. */
+void test_replace_split(TestContext &ctx) {
+    ctx.DESC("Regex replaceAll()");
+
+    CompiledRegex digits("[0123456789]+");
+    ctx.CHECK(digits.replaceAll("card 1234 pin 99", "#") == "card # pin #");
+    ctx.CHECK(digits.replaceAll("no numbers", "#") == "no numbers");
+    ctx.CHECK(digits.replaceAll("", "#") == "");
+    ctx.CHECK(digits.replaceAll("7", "<$0>") == "<7>");
+    ctx.CHECK(digits.replaceAll("a1b22", "[$0|$$|$1]") ==
+              "a[1|$|$1]b[22|$|$1]");
+
+    CompiledRegex secret("key=[^ ]*");
+    ctx.CHECK(secret.replaceAll("user=x key=abc key= z", "key=***") ==
+              "user=x key=*** key=*** z");
+
+    CompiledRegex literal("ab");
+    ctx.CHECK(literal.replaceAll("abcabab", "x") == "xcxx");
+
+    // Empty matches are replaced, and the search moves past them.
+    CompiledRegex optional("a*");
+    ctx.CHECK(optional.replaceAll("baac", "-") == "-b--c");
+
+    // A long input goes through the DFA, with the same results.
+    string big;
+    for (int i = 0; i < 1000; i++)
+        big += "word 12 ";
+    string expected;
+    for (int i = 0; i < 1000; i++)
+        expected += "word # ";
+    ctx.CHECK(digits.replaceAll(big, "#") == expected);
+    ctx.CHECK(digits.getCalls(CompiledRegex::Engine::DFA) > 0);
+
+    ctx.result();
+
+    ctx.DESC("Regex split()");
+
+    CompiledRegex commas(" *, *");
+    vector<Range> pieces = commas.split("a, b ,c,,d");
+    ctx.CHECK(pieces.size() == 5);
+    string joined;
+    for (const Range &r : pieces)
+        joined += "[" + string("a, b ,c,,d").substr(r.start, r.end - r.start) +
+            "]";
+    ctx.CHECK(joined == "[a][b][c][][d]");
+
+    pieces = commas.split("");
+    ctx.CHECK(pieces.size() == 1 && pieces[0].start == 0 &&
+              pieces[0].end == 0);
+
+    pieces = commas.split(",x,");
+    ctx.CHECK(pieces.size() == 3);
+    ctx.CHECK(pieces[1].start == 1 && pieces[1].end == 2);
+    ctx.CHECK(pieces[2].start == 3 && pieces[2].end == 3);
+
+    // Empty matches do not split.
+    pieces = optional.split("baac");
+    ctx.CHECK(pieces.size() == 2);
+    ctx.CHECK(pieces[0].start == 0 && pieces[0].end == 1);
+    ctx.CHECK(pieces[1].start == 3 && pieces[1].end == 4);
+
+    ctx.result();
+}
+
+
+/*! Test the static complexity analysis, and the policies that act on it. */
+void test_complexity(TestContext &ctx) {
+    ctx.DESC("Static complexity analysis");
+
+    struct { const char *pattern; int degree; } cases[] = {
+        { "abc", 1 }, { "a[bc]?d", 1 }, { "a.*c", 2 }, { "a*b*c", 2 },
+        { "a*a*", 3 }, { ".*.*c", 3 }, { ".*x.*", 3 }, { "a*b?a*", 3 },
+        { "a*ba*", 2 }, { ".*x.*x.*", 4 }, { "[ab]+[bc]+[cd]+", 3 }
+    };
+    for (auto &c : cases) {
+        vector<RegexOperator *> regex = parseRegex(c.pattern);
+        ctx.CHECK(analyzeRegex(regex).degree == c.degree);
+        clearRegex(regex);
+    }
+
+    vector<RegexOperator *> regex = parseRegex("ab*c.*d");
+    RegexComplexity complexity = analyzeRegex(regex);
+    ctx.CHECK(complexity.ambiguousSteps.size() == 1);
+    clearRegex(regex);
+
+    regex = parseRegex("xa*.a+");
+    complexity = analyzeRegex(regex);
+    ctx.CHECK(complexity.ambiguousSteps == vector<int>({ 1, 3 }));
+    ctx.CHECK(complexity.sharedChar == 'a');
+    clearRegex(regex);
+
+    ctx.result();
+
+    ctx.DESC("Complexity policies");
+
+    CompiledRegex allowed(".*.*c");
+    ctx.CHECK(allowed.ok());
+    ctx.CHECK(allowed.getComplexity().degree == 3);
+
+    ComplexityPolicy reject(2, ComplexityAction::REJECT);
+    ctx.CHECK(!CompiledRegex(".*.*c", 0, reject).ok());
+    ctx.CHECK(CompiledRegex("a.*c", 0, reject).ok());
+
+    // With a limit of 0, no pattern may use the backtracker.
+    ComplexityPolicy linear(0, ComplexityAction::FORCE_LINEAR);
+    CompiledRegex forced("a[bc]d", 0, linear);
+    ctx.CHECK(forced.ok());
+    ctx.CHECK(forced.chooseEngine(10) != CompiledRegex::Engine::BACKTRACK);
+    ctx.CHECK(forced.find("xabd").start == 1);
+
+    CompiledRegex unforced("a[bc]d");
+    ctx.CHECK(unforced.chooseEngine(10) == CompiledRegex::Engine::BACKTRACK);
+
+    ctx.result();
+
+    ctx.DESC("Ambiguous patterns stay fast on hostile input");
+
+    // The backtracker needs about n^4 steps here; a linear engine must be
+    // used, or this will not finish in time.
+    ComplexityPolicy strict(2, ComplexityAction::FORCE_LINEAR);
+    CompiledRegex hostile(".*.*.*c", 0, strict);
+    string s(200000, 'a');
+    ctx.CHECK(hostile.ok());
+    ctx.CHECK_WITHIN(500, hostile.find(s).start == -1);
+    ctx.CHECK_WITHIN(500, hostile.find(s + "c").end == (int) s.length() + 1);
+
+    ctx.result();
+}
+
+
+/*! Test the substring search used for literal regexes. */
+void test_literal_search(TestContext &ctx) {
+    const char *literals[] = { "a", "ab", "abc", "abcab", "needle", "aaaa" };
+    const char *strings[] = {
+        "", "a", "abcabcab", "xxabcabxxabcab", "haystack with a needle",
+        "needl", "aaabaaaab", "aaaaaaa"
+    };
+
+    ctx.DESC("Literal search agrees with string::find()");
+
+    for (const char *lit : literals) {
+        LiteralSearcher searcher(lit);
+        for (const char *str : strings) {
+            string s = str;
+            for (int from = 0; from <= (int) s.length(); from++) {
+                size_t expected = s.find(lit, from);
+                int index = searcher.find(s, from);
+                ctx.CHECK(expected == string::npos ? index == -1 :
+                          index == (int) expected);
+            }
+        }
+    }
+
+    ctx.result();
+
+    vector<RegexOperator *> regex = parseRegex("needle");
+
+    ctx.DESC("Literal regex with find() and match()");
+
+    Range r = find(regex, "haystack with a needle and a needle");
+    ctx.CHECK(r.start == 16 && r.end == 22);
+
+    r = find(regex, "needl");
+    ctx.CHECK(r.start == -1 && r.end == -1);
+
+    ctx.CHECK(match(regex, "needle"));
+    ctx.CHECK(!match(regex, "needles"));
+
+    ctx.result();
+
+    clearRegex(regex);
+}
+
+
+/*! Test searching for a batch of patterns at once. */
+void test_batch(TestContext &ctx) {
+    RegexBatch literals({ "he", "she", "his", "hers" });
+    vector<PatternHit> hits;
+
+    ctx.DESC("Literal batch uses Aho-Corasick");
+
+    ctx.CHECK(literals.usesAhoCorasick());
+
+    hits = literals.findAll("ushers");
+    ctx.CHECK(hits.size() == 3);
+    ctx.CHECK(hits[0].pattern == 0 && hits[0].range.start == 2 &&
+              hits[0].range.end == 4);
+    ctx.CHECK(hits[1].pattern == 1 && hits[1].range.start == 1 &&
+              hits[1].range.end == 4);
+    ctx.CHECK(hits[2].pattern == 3 && hits[2].range.start == 2 &&
+              hits[2].range.end == 6);
+
+    hits = literals.findAll("hishehe");
+    ctx.CHECK(hits.size() == 4);
+
+    ctx.CHECK(literals.findAll("xyz").empty());
+
+    ctx.result();
+
+    RegexBatch mixed({ "he", "s.e", "hehe" });
+
+    ctx.DESC("Mixed batch falls back to backtracking");
+
+    ctx.CHECK(!mixed.usesAhoCorasick());
+
+    hits = mixed.findAll("ushers");
+    ctx.CHECK(hits.size() == 2);
+    ctx.CHECK(hits[0].pattern == 0 && hits[0].range.start == 2 &&
+              hits[0].range.end == 4);
+    ctx.CHECK(hits[1].pattern == 1 && hits[1].range.start == 1 &&
+              hits[1].range.end == 4);
+
+    // Literals in a mixed batch still report overlapping occurrences.
+    hits = mixed.findAll("hehehe");
+    ctx.CHECK(hits.size() == 5);
+    ctx.CHECK(hits[2].pattern == 2 && hits[2].range.start == 0 &&
+              hits[2].range.end == 4);
+    ctx.CHECK(hits[4].pattern == 2 && hits[4].range.start == 2 &&
+              hits[4].range.end == 6);
+
+    ctx.result();
+}
+
+
+/*! Benchmark each engine's find() on the same input, and check that the
+ *  results are recorded for the JSON report.
+ */
+void bench_engines(TestContext &ctx) {
+    const char *pattern = "ab[cd]+e.*xyz";
+    string s;
+    for (int i = 0; i < 4096; i++)
+        s += "abcdf-ab.e---";
+    s += "abcdexyz";
+
+    vector<RegexOperator *> regex = parseRegex(pattern);
+    DFA dfa(regex);
+    ShiftAnd shiftAnd(regex);
+    LiteralSearcher literal("abcdexyz");
+
+    ctx.BENCH("Bench: backtracking find() on 52 KiB", [&]() {
+        return find(regex, s).start;
+    });
+    ctx.BENCH("Bench: Shift-And find() on 52 KiB", [&]() {
+        return shiftAnd.find(s).start;
+    });
+    ctx.BENCH("Bench: DFA find() on 52 KiB", [&]() {
+        return dfa.find(s).start;
+    });
+    ctx.BENCH("Bench: literal search on 52 KiB", [&]() {
+        return literal.find(s);
+    });
+
+    clearRegex(regex);
+
+    ctx.DESC("Benchmark results are written as JSON");
+
+    ostringstream json;
+    ctx.writeBenchJSON(json);
+    ctx.CHECK(json.str().find("\"name\": \"Bench: DFA find() on 52 KiB\"") !=
+              string::npos);
+    ctx.CHECK(json.str().find("\"median_ns\": ") != string::npos);
+
+    // The stream's own formatting is left as it was.
+    ctx.CHECK(!(json.flags() & ios::fixed) && json.precision() == 6);
+
+    ctx.result();
+}
+
+
 /*! This program is a simple test-suite for the Rational class. */
-int main() {
+int main(int argc, char **argv) {
   
     cout << "Testing regular expressions." << endl << endl;
 
     TestContext ctx(cout);
+    ctx.setTimeBudget(TEST_TIME_BUDGET_MS);
 
     test_simple_regex(ctx);
     test_simple_wildcards(ctx);
@@ -463,6 +1270,25 @@ int main() {
     test_plus(ctx);
     test_optional(ctx);
     test_complex_regex(ctx);
+    test_skip_ahead(ctx);
+    test_literal_runs(ctx);
+    test_case_insensitive(ctx);
+    test_dfa(ctx);
+    test_literal_search(ctx);
+    test_shift_and(ctx);
+    test_approx(ctx);
+    test_trigram_index(ctx);
+    test_compiled_regex(ctx);
+    test_replace_split(ctx);
+    test_complexity(ctx);
+    test_batch(ctx);
+    bench_engines(ctx);
+
+    // If a file name is given, write the benchmark results to it as JSON.
+    if (argc > 1) {
+        ofstream out(argv[1]);
+        ctx.writeBenchJSON(out);
+    }
     
     // Return 0 if everything passed, nonzero if something failed.
     return !ctx.ok();
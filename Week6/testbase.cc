@@ -1,12 +1,14 @@
 #include "testbase.hh"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <sstream>
 
 
 TestContext::TestContext(ostream &os) : os(os), passed(0), total(0),
-    lastline(0), skip(false) {
+    lastline(0), skip(false), budgetMs(0), testLine(0), testRunning(false),
+    stopping(false) {
 
     os << "line: ";
     os.width(65);
@@ -33,6 +35,13 @@ void TestContext::desc(const string &msg, int line) {
     
     lastline = line;
     skip = true;
+
+    lock_guard<mutex> guard(watchLock);
+    testStart = chrono::steady_clock::now();
+    testDesc = msg;
+    testLine = line;
+    testRunning = true;
+    watchWake.notify_all();
 }
 
 
@@ -42,8 +51,96 @@ void TestContext::check(bool test, int line) {
 }
 
 
+/* Records a check that must pass, and must also finish evaluating within
+ * the given number of milliseconds.
+ */
+void TestContext::checkWithin(double ms, const function<bool()> &test,
+                              int line) {
+    auto start = chrono::steady_clock::now();
+    bool passed = test();
+    double took = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+
+    if (!passed) {
+        badlines.insert(line);
+    }
+    else if (took > ms) {
+        badlines.insert(line);
+        ostringstream note;
+        note << "took " << took << " ms, limit " << ms << " ms";
+        notes[line] = note.str();
+    }
+}
+
+
+/* Records a check that a count of work done (such as engine steps) is
+ * within its limit.
+ */
+void TestContext::checkAtMost(long limit, long value, int line) {
+    if (value > limit) {
+        badlines.insert(line);
+        notes[line] = to_string(value) + " is over the limit of " +
+            to_string(limit);
+    }
+}
+
+
+/* Sets the time each test, from desc() to result(), may take.  A test that
+ * finishes late fails; one still running when its time is up is reported by
+ * a watchdog thread, which then ends the program, since a test stuck in
+ * runaway backtracking would otherwise never finish.
+ */
+void TestContext::setTimeBudget(long ms) {
+    lock_guard<mutex> guard(watchLock);
+    budgetMs = ms;
+    if (ms > 0 && !watchdog.joinable())
+        watchdog = thread(&TestContext::watch, this);
+    watchWake.notify_all();
+}
+
+
+void TestContext::watch() {
+    unique_lock<mutex> guard(watchLock);
+    while (!stopping) {
+        if (!testRunning || budgetMs == 0) {
+            watchWake.wait(guard);
+            continue;
+        }
+
+        auto deadline = testStart + chrono::milliseconds(budgetMs);
+        watchWake.wait_until(guard, deadline);
+
+        if (!stopping && testRunning && budgetMs > 0 &&
+            chrono::steady_clock::now() >=
+                testStart + chrono::milliseconds(budgetMs)) {
+            os << "TIMEOUT" << endl
+               << "\tTest on line " << testLine << " (\"" << testDesc
+               << "\") is still running after its " << budgetMs
+               << " ms budget; aborting." << endl;
+            os.flush();
+            _Exit(1);
+        }
+    }
+}
+
+
 void TestContext::result() {
     assert(lastline != 0);
+
+    {
+        lock_guard<mutex> guard(watchLock);
+        testRunning = false;
+
+        double took = chrono::duration<double, milli>(
+            chrono::steady_clock::now() - testStart).count();
+        if (budgetMs > 0 && took > budgetMs) {
+            badlines.insert(lastline);
+            ostringstream note;
+            note << "test took " << took << " ms, budget " << budgetMs
+                 << " ms";
+            notes[lastline] = note.str();
+        }
+    }
     
     // See if we haven't added any more values to the badlines collection
     auto iter = badlines.lower_bound(lastline);
@@ -55,7 +152,10 @@ void TestContext::result() {
         os << "ERROR" << endl;
         
         while (iter != badlines.end()) {
-            os << "\tFailure detected on line " << *iter << endl;
+            os << "\tFailure detected on line " << *iter;
+            if (notes.count(*iter) != 0)
+                os << " (" << notes[*iter] << ")";
+            os << endl;
             iter++;
         }
     }
@@ -65,6 +165,15 @@ void TestContext::result() {
 }
 
 TestContext::~TestContext() {
+    if (watchdog.joinable()) {
+        {
+            lock_guard<mutex> guard(watchLock);
+            stopping = true;
+            watchWake.notify_all();
+        }
+        watchdog.join();
+    }
+
     os << endl << "Passed " << passed << "/" << total << " tests." << endl
        << endl;
 
@@ -79,3 +188,98 @@ TestContext::~TestContext() {
 bool TestContext::ok() const {
     return passed == total;
 }
+
+
+/* Returns the median of the values, which are reordered. */
+static double median(vector<double> &values) {
+    size_t mid = values.size() / 2;
+    nth_element(values.begin(), values.begin() + mid, values.end());
+    return values[mid];
+}
+
+
+/* Formats a time in ns with a unit that keeps the number readable. */
+static string formatTime(double ns) {
+    ostringstream out;
+    out.setf(ios::fixed);
+    out.precision(1);
+    if (ns >= 1e6)
+        out << ns / 1e6 << " ms";
+    else if (ns >= 1e3)
+        out << ns / 1e3 << " us";
+    else
+        out << ns << " ns";
+    return out.str();
+}
+
+
+/* Summarizes one benchmark's samples (in ns per call) and writes a line for
+ * it.  Benchmarks do not count as tests; they only report, so they belong
+ * outside any DESC() ... result() block.
+ */
+void TestContext::recordBench(const string &name, int line, long iterations,
+                              vector<double> &samples) {
+    assert(lastline == 0);
+
+    BenchResult r;
+    r.name = name;
+    r.line = line;
+    r.iterations = iterations;
+    r.samples = samples.size();
+
+    sort(samples.begin(), samples.end());
+    r.p99 = samples[(samples.size() * 99 - 1) / 100];
+    r.median = median(samples);
+
+    vector<double> deviations;
+    for (double s : samples)
+        deviations.push_back(fabs(s - r.median));
+    r.mad = median(deviations);
+
+    benches.push_back(r);
+
+    os.width(4);
+    os << line << ": ";
+    os.width(65);
+    os.setf(ios::left, ios::adjustfield);
+    os << name << " ";
+    os.setf(ios::right, ios::adjustfield);
+    os << "bench" << endl;
+
+    os << "\tmedian " << formatTime(r.median) << ", MAD " << formatTime(r.mad)
+       << ", p99 " << formatTime(r.p99) << " (" << r.samples << " x "
+       << r.iterations << " calls)" << endl;
+}
+
+
+/* Writes every benchmark result so far as a JSON array, one object per
+ * benchmark, with times in ns per call.  The numbers are formatted in a
+ * local stream, as formatTime() does, so the caller's stream keeps its
+ * settings.
+ */
+void TestContext::writeBenchJSON(ostream &out) const {
+    ostringstream json;
+    json.setf(ios::fixed);
+    json.precision(1);
+    json << "[" << endl;
+    for (size_t i = 0; i < benches.size(); i++) {
+        const BenchResult &r = benches[i];
+
+        string name;
+        for (char c : r.name) {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+
+        json << "  { \"name\": \"" << name << "\", \"line\": " << r.line
+            << ", \"iterations\": " << r.iterations
+            << ", \"samples\": " << r.samples
+            << ", \"median_ns\": " << r.median
+            << ", \"mad_ns\": " << r.mad
+            << ", \"p99_ns\": " << r.p99 << " }"
+            << (i + 1 < benches.size() ? "," : "") << endl;
+    }
+    json << "]" << endl;
+    out << json.str();
+}
@@ -2,37 +2,157 @@
 #define TESTBASE_HH
 
 
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include <cmath>
 
 using namespace std;
 
 
+/* Keeps the compiler from optimizing away a value that a benchmark computes
+ * but never uses, without adding any real work to the measured loop.
+ */
+template <typename T>
+inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+#endif
+}
+
+
+struct BenchResult {                        // timings in ns per iteration
+    string name;
+    int line;
+    long iterations;                        // iterations per sample
+    int samples;
+    double median;
+    double mad;                             // median absolute deviation
+    double p99;
+};
+
+
 class TestContext {                         // displays test results
     ostream &os;                            // output stream to use
     int passed;                             // # of tests which passed
     int total;                              // total # of tests
     int lastline;                           // line # of most recent test
     set<int> badlines;                      // line #'s of failed tests
+    map<int, string> notes;                 // why some checks failed
     bool skip;                              // skip a line before title?
+    vector<BenchResult> benches;            // results of bench() calls
+
+    long budgetMs;                          // per-test time limit, or 0
+    chrono::steady_clock::time_point testStart;
+    string testDesc;                        // description of current test
+    int testLine;                           // line # of current test
+
+    thread watchdog;                        // aborts over-budget tests
+    mutex watchLock;                        // guards the fields below
+    condition_variable watchWake;
+    bool testRunning;                       // between desc() and result()
+    bool stopping;                          // destructor is running
+
+    void watch();                           // the watchdog thread
+
+    template <typename F>                   // time one batch of calls
+    static double timeBatch(F &f, long iterations);
+    void recordBench(const string &name, int line, long iterations,
+                     vector<double> &samples);
 
 public:
+    static const int BENCH_SAMPLES = 101;   // batches timed per benchmark
+    static const long BENCH_MIN_BATCH_NS = 200000;
+    static const long BENCH_WARMUP_NS = 20000000;
+
     TestContext(ostream &os);               // write header to stream
     ~TestContext();                         // write summary info
 
     void desc(const string &msg, int line); // write line/description
     void check(bool test, int line);        // record if a check passes
+    void checkWithin(double ms, const function<bool()> &test, int line);
+    void checkAtMost(long limit, long value, int line);
+
+    void setTimeBudget(long ms);            // per-test limit, 0 for none
 
     void result();                          // write test result
     bool ok() const;                        // true iff all tests passed
+
+    template <typename F>                   // time a callable
+    void bench(const string &name, F f, int line);
+    void writeBenchJSON(ostream &out) const;
 };
 
 
 // ugly hacks
 #define DESC(x) desc(x, __LINE__)
 #define CHECK(test) check(test, __LINE__)
+#define CHECK_WITHIN(ms, test) \
+    checkWithin(ms, [&]() { return (bool) (test); }, __LINE__)
+#define CHECK_AT_MOST(limit, value) checkAtMost(limit, value, __LINE__)
+#define BENCH(name, f) bench(name, f, __LINE__)
+
+
+/* Calls f, feeding its result (if it has one) to doNotOptimize(). */
+template <typename F>
+inline auto benchCall(F &f)
+    -> typename enable_if<!is_void<decltype(f())>::value>::type {
+    doNotOptimize(f());
+}
+
+template <typename F>
+inline auto benchCall(F &f)
+    -> typename enable_if<is_void<decltype(f())>::value>::type {
+    f();
+}
+
+
+/* Returns the time in ns that iterations calls to f take. */
+template <typename F>
+double TestContext::timeBatch(F &f, long iterations) {
+    auto start = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+        benchCall(f);
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - start).count();
+}
+
+
+/* Benchmarks f:  the number of calls per batch is doubled until a batch
+ * takes at least BENCH_MIN_BATCH_NS, batches are run untimed for
+ * BENCH_WARMUP_NS to warm caches and branch predictors, and then
+ * BENCH_SAMPLES batches are timed.  The per-call median, MAD and 99th
+ * percentile are reported and kept for writeBenchJSON().
+ */
+template <typename F>
+void TestContext::bench(const string &name, F f, int line) {
+    long iterations = 1;
+    double batch = timeBatch(f, iterations);
+    while (batch < BENCH_MIN_BATCH_NS) {
+        iterations *= 2;
+        batch = timeBatch(f, iterations);
+    }
+
+    for (double warm = 0; warm < BENCH_WARMUP_NS; )
+        warm += timeBatch(f, iterations);
+
+    vector<double> samples;
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+        samples.push_back(timeBatch(f, iterations) / iterations);
+
+    recordBench(name, line, iterations, samples);
+}
 
 inline bool epsilon_equals(float a, float b, float epsilon = 0.00001) {
     return (fabsf(a - b) <= epsilon);
@@ -0,0 +1,54 @@
+#include "trigram-index.hh"
+
+#include <iostream>
+
+using namespace std;
+
+
+/* This program indexes a fixed set of documents, so that trigram-search can
+ * answer regex queries over them without reading every document.  Each file
+ * named on the command line is one document.
+ */
+
+
+/*! Prints a usage statement for the program. */
+void printUsage(char *name)
+{
+    cerr << "Usage: " << name << " INDEX-FILE DOCUMENT..." << endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    vector<string> docPaths;
+    for(int i = 2; i < argc; i++)
+    {
+        docPaths.push_back(argv[i]);
+    }
+
+    string error;
+    if(!writeTrigramIndex(argv[1], docPaths, error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+
+    // Load the index back, so a bad file is caught here rather than by
+    // every search.
+    TrigramIndex index;
+    if(!index.open(argv[1], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+
+    cout << "Indexed " << index.numDocs() << " documents into " << argv[1]
+         << endl;
+    return 0;
+}
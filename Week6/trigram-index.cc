@@ -0,0 +1,477 @@
+#include "trigram-index.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/* Adds a clause for every window of three consecutive sets in run, as long as
+ * the window does not allow too many trigrams.
+ */
+static void addRunClauses(const vector<bitset<256>> &run,
+                          vector<vector<uint32_t>> &clauses) {
+    for (int i = 0; i + 3 <= (int) run.size(); i++) {
+        long alternatives = (long) run[i].count() * run[i + 1].count() *
+            run[i + 2].count();
+        if (alternatives == 0 || alternatives > MAX_TRIGRAM_ALTERNATIVES)
+            continue;
+
+        vector<uint32_t> clause;
+        for (int a = 0; a < 256; a++) {
+            if (!run[i][a])
+                continue;
+            for (int b = 0; b < 256; b++) {
+                if (!run[i + 1][b])
+                    continue;
+                for (int c = 0; c < 256; c++) {
+                    if (run[i + 2][c])
+                        clause.push_back((a << 16) | (b << 8) | c);
+                }
+            }
+        }
+        clauses.push_back(clause);
+    }
+}
+
+
+/* Works out which trigrams a match must contain.  The regex is split into
+ * runs of operators whose characters are certain to be adjacent in any
+ * match:  an optional operator ends a run, since it may not be there at all,
+ * and an operator that may repeat ends one run and starts the next, since
+ * its last repetition is next to what follows but its first may not be.
+ * Every window of three sets in a run gives one clause.
+ */
+TrigramQuery planTrigramQuery(const vector<RegexOperator *> &regex) {
+    TrigramQuery query;
+    vector<bitset<256>> run;
+
+    for (const RegexStep &step : flattenRegex(regex)) {
+        if (step.minRepeat == 0) {
+            addRunClauses(run, query.clauses);
+            run.clear();
+            continue;
+        }
+
+        run.push_back(step.chars);
+        if (step.maxRepeat != 1) {
+            addRunClauses(run, query.clauses);
+            run.clear();
+            run.push_back(step.chars);
+        }
+    }
+    addRunClauses(run, query.clauses);
+
+    // Repeated text in the pattern gives repeated clauses.
+    sort(query.clauses.begin(), query.clauses.end());
+    query.clauses.erase(unique(query.clauses.begin(), query.clauses.end()),
+                        query.clauses.end());
+    return query;
+}
+
+
+/* A posting list under construction, already in its compressed form. */
+struct PostingBuilder {
+    vector<uint8_t> bytes;
+    uint32_t lastDoc;
+    uint32_t numDocs;
+
+    PostingBuilder() : lastDoc(0), numDocs(0) {}
+
+    void add(uint32_t doc) {
+        uint32_t gap = doc - lastDoc;
+        while (gap >= 0x80) {
+            bytes.push_back((gap & 0x7f) | 0x80);
+            gap >>= 7;
+        }
+        bytes.push_back(gap);
+        lastDoc = doc;
+        numDocs++;
+    }
+};
+
+
+// Documents are read in blocks of this size, so that a document never has to
+// fit in memory.
+const int READ_BLOCK_SIZE = 1 << 20;
+
+/* Adds every distinct trigram in the document at path to found.  seen has
+ * one flag per trigram, all clear on entry and on return.  The document's
+ * size is stored in docSize.
+ */
+static bool readTrigrams(const string &path, vector<bool> &seen,
+                         vector<uint32_t> &found, uint64_t &docSize) {
+    ifstream in(path, ios::binary);
+    if (!in)
+        return false;
+
+    vector<char> block(READ_BLOCK_SIZE);
+    uint32_t window = 0;
+    docSize = 0;
+
+    while (in) {
+        in.read(block.data(), block.size());
+        streamsize n = in.gcount();
+        for (streamsize i = 0; i < n; i++) {
+            window = ((window << 8) | (unsigned char) block[i]) & 0xffffff;
+            docSize++;
+            if (docSize >= 3 && !seen[window]) {
+                seen[window] = true;
+                found.push_back(window);
+            }
+        }
+    }
+    if (in.bad())
+        return false;
+
+    for (uint32_t t : found)
+        seen[t] = false;
+    return true;
+}
+
+
+/* Rounds offset up to the next multiple of 8. */
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~((uint64_t) 7);
+}
+
+
+bool writeTrigramIndex(const string &path, const vector<string> &docPaths,
+                       string &error) {
+    unordered_map<uint32_t, PostingBuilder> postings;
+    vector<uint64_t> docSizes;
+    vector<bool> seen(1 << 24);
+    vector<uint32_t> found;
+
+    for (uint32_t d = 0; d < docPaths.size(); d++) {
+        uint64_t docSize;
+        found.clear();
+        if (!readTrigrams(docPaths[d], seen, found, docSize)) {
+            error = "could not read " + docPaths[d];
+            return false;
+        }
+        docSizes.push_back(docSize);
+        for (uint32_t t : found)
+            postings[t].add(d);
+    }
+
+    vector<uint32_t> trigrams;
+    for (const auto &p : postings)
+        trigrams.push_back(p.first);
+    sort(trigrams.begin(), trigrams.end());
+
+    TrigramIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRIGRAM_INDEX_MAGIC, sizeof(header.magic));
+    header.version = TRIGRAM_INDEX_VERSION;
+    header.byteOrder = TRIGRAM_INDEX_BYTE_ORDER;
+    header.numDocs = docPaths.size();
+    header.numTrigrams = trigrams.size();
+
+    uint64_t offset = sizeof(TrigramIndexHeader) +
+        docPaths.size() * sizeof(TrigramIndexDoc) +
+        trigrams.size() * sizeof(TrigramIndexEntry);
+
+    vector<TrigramIndexDoc> docs(docPaths.size());
+    for (int d = 0; d < (int) docPaths.size(); d++) {
+        memset(&docs[d], 0, sizeof(TrigramIndexDoc));
+        docs[d].pathOffset = offset;
+        docs[d].pathLength = docPaths[d].length();
+        docs[d].size = docSizes[d];
+        offset += docs[d].pathLength;
+    }
+    uint64_t pathsEnd = offset;
+    offset = align8(offset);
+
+    vector<TrigramIndexEntry> entries(trigrams.size());
+    for (int i = 0; i < (int) trigrams.size(); i++) {
+        const PostingBuilder &b = postings[trigrams[i]];
+        memset(&entries[i], 0, sizeof(TrigramIndexEntry));
+        entries[i].postingOffset = offset;
+        entries[i].postingLength = b.bytes.size();
+        entries[i].trigram = trigrams[i];
+        entries[i].numDocs = b.numDocs;
+        offset += b.bytes.size();
+    }
+    header.fileSize = offset;
+
+    // The posting lists can be large, so the file is written piece by piece
+    // rather than assembled in memory first.
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) docs.data(),
+              docs.size() * sizeof(TrigramIndexDoc));
+    out.write((const char *) entries.data(),
+              entries.size() * sizeof(TrigramIndexEntry));
+    for (const string &p : docPaths)
+        out.write(p.data(), p.length());
+
+    static const char padding[8] = { 0 };
+    out.write(padding, align8(pathsEnd) - pathsEnd);
+
+    for (uint32_t t : trigrams) {
+        const vector<uint8_t> &bytes = postings[t].bytes;
+        out.write((const char *) bytes.data(), bytes.size());
+    }
+
+    out.close();
+    if (!out) {
+        error = "could not write " + path;
+        return false;
+    }
+    return true;
+}
+
+
+/* Returns true if the length bytes at offset lie inside a file of the given
+ * size, without overflowing on hostile offsets.
+ */
+static bool inFile(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+
+TrigramIndex::TrigramIndex() {
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+    docs = nullptr;
+    entries = nullptr;
+}
+
+TrigramIndex::~TrigramIndex() {
+    close();
+}
+
+
+/* Maps the index at path and checks that it is well formed. */
+bool TrigramIndex::open(const string &path, string &error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        error = "could not open " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 ||
+        st.st_size < (off_t) sizeof(TrigramIndexHeader)) {
+        ::close(fd);
+        error = path + " is too small to be a trigram index";
+        return false;
+    }
+
+    size = st.st_size;
+    base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (base == MAP_FAILED) {
+        base = nullptr;
+        size = 0;
+        error = "could not map " + path;
+        return false;
+    }
+
+    if (!validate(error)) {
+        error = path + ": " + error;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+/* Checks the header, and that every path and posting list lies inside the
+ * file and the trigram table is sorted.  The posting lists themselves are
+ * only checked as they are decoded, so that opening a large index does not
+ * read all of it.
+ */
+bool TrigramIndex::validate(string &error) {
+    const char *bytes = (const char *) base;
+    header = (const TrigramIndexHeader *) bytes;
+
+    if (memcmp(header->magic, TRIGRAM_INDEX_MAGIC,
+               sizeof(header->magic)) != 0) {
+        error = "not a trigram index";
+        return false;
+    }
+    if (header->byteOrder != TRIGRAM_INDEX_BYTE_ORDER) {
+        error = "written on a machine with a different byte order";
+        return false;
+    }
+    if (header->version != TRIGRAM_INDEX_VERSION) {
+        error = "unsupported version " + to_string(header->version);
+        return false;
+    }
+    if (header->fileSize != size) {
+        error = "truncated or padded file";
+        return false;
+    }
+
+    uint64_t docsSize = (uint64_t) header->numDocs * sizeof(TrigramIndexDoc);
+    uint64_t entriesSize =
+        (uint64_t) header->numTrigrams * sizeof(TrigramIndexEntry);
+    if (!inFile(sizeof(TrigramIndexHeader), docsSize + entriesSize, size)) {
+        error = "tables run past the end of the file";
+        return false;
+    }
+
+    docs = (const TrigramIndexDoc *) (bytes + sizeof(TrigramIndexHeader));
+    entries = (const TrigramIndexEntry *) (bytes +
+        sizeof(TrigramIndexHeader) + docsSize);
+
+    for (uint32_t d = 0; d < header->numDocs; d++) {
+        if (!inFile(docs[d].pathOffset, docs[d].pathLength, size)) {
+            error = "document " + to_string(d) + " is malformed";
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->numTrigrams; i++) {
+        const TrigramIndexEntry &e = entries[i];
+        if (e.trigram > 0xffffff || e.numDocs > header->numDocs ||
+            (i > 0 && e.trigram <= entries[i - 1].trigram) ||
+            !inFile(e.postingOffset, e.postingLength, size)) {
+            error = "trigram entry " + to_string(i) + " is malformed";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+void TrigramIndex::close() {
+    if (base != nullptr)
+        munmap(base, size);
+    base = nullptr;
+    size = 0;
+    header = nullptr;
+    docs = nullptr;
+    entries = nullptr;
+}
+
+
+int TrigramIndex::numDocs() const {
+    return header->numDocs;
+}
+
+string TrigramIndex::getDocPath(int i) const {
+    return string((const char *) base + docs[i].pathOffset,
+                  docs[i].pathLength);
+}
+
+uint64_t TrigramIndex::getDocSize(int i) const {
+    return docs[i].size;
+}
+
+
+/* Returns the table entry for a trigram, or null if no document has it. */
+const TrigramIndexEntry * TrigramIndex::findEntry(uint32_t trigram) const {
+    const TrigramIndexEntry *end = entries + header->numTrigrams;
+    const TrigramIndexEntry *e = lower_bound(entries, end, trigram,
+        [](const TrigramIndexEntry &entry, uint32_t t) {
+            return entry.trigram < t;
+        });
+    if (e == end || e->trigram != trigram)
+        return nullptr;
+    return e;
+}
+
+int TrigramIndex::countDocs(uint32_t trigram) const {
+    const TrigramIndexEntry *e = findEntry(trigram);
+    return e == nullptr ? 0 : e->numDocs;
+}
+
+
+/* Appends the documents in a posting list to out.  A malformed list is cut
+ * short rather than read past its end or allowed to name a nonexistent
+ * document.
+ */
+void TrigramIndex::decodePostings(const TrigramIndexEntry &entry,
+                                  vector<uint32_t> &out) const {
+    const uint8_t *p = (const uint8_t *) base + entry.postingOffset;
+    const uint8_t *end = p + entry.postingLength;
+
+    uint64_t doc = 0;
+    for (uint32_t n = 0; n < entry.numDocs; n++) {
+        uint64_t gap = 0;
+        int shift = 0;
+        while (p < end && (*p & 0x80) && shift < 28) {
+            gap |= (uint64_t) (*p & 0x7f) << shift;
+            shift += 7;
+            p++;
+        }
+        if (p == end || (*p & 0x80))
+            return;
+        gap |= (uint64_t) *p << shift;
+        p++;
+
+        doc += gap;
+        if (doc >= header->numDocs || (n > 0 && gap == 0))
+            return;
+        out.push_back(doc);
+    }
+}
+
+
+/* Stores in out the sorted documents that contain any trigram in clause. */
+void TrigramIndex::clauseDocs(const vector<uint32_t> &clause,
+                              vector<uint32_t> &out) const {
+    out.clear();
+    for (uint32_t t : clause) {
+        const TrigramIndexEntry *e = findEntry(t);
+        if (e != nullptr)
+            decodePostings(*e, out);
+    }
+    if (clause.size() > 1) {
+        sort(out.begin(), out.end());
+        out.erase(unique(out.begin(), out.end()), out.end());
+    }
+}
+
+
+/* Stores in docs the documents that could match the query, in increasing
+ * order.  The clauses are evaluated from the fewest documents to the most,
+ * so the candidate set shrinks as quickly as possible, and evaluation stops
+ * as soon as it is empty.
+ */
+void TrigramIndex::candidates(const TrigramQuery &query,
+                              vector<int> &docs) const {
+    docs.clear();
+    if (query.matchesAll()) {
+        for (int d = 0; d < numDocs(); d++)
+            docs.push_back(d);
+        return;
+    }
+
+    vector<pair<long, int>> order;
+    for (int i = 0; i < (int) query.clauses.size(); i++) {
+        long cost = 0;
+        for (uint32_t t : query.clauses[i])
+            cost += countDocs(t);
+        order.push_back(make_pair(cost, i));
+    }
+    sort(order.begin(), order.end());
+
+    vector<uint32_t> result, clause, both;
+    clauseDocs(query.clauses[order[0].second], result);
+
+    for (int i = 1; i < (int) order.size() && !result.empty(); i++) {
+        clauseDocs(query.clauses[order[i].second], clause);
+        both.clear();
+        set_intersection(result.begin(), result.end(),
+                         clause.begin(), clause.end(), back_inserter(both));
+        result.swap(both);
+    }
+
+    docs.assign(result.begin(), result.end());
+}
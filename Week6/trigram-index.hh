@@ -0,0 +1,127 @@
+#ifndef TRIGRAM_INDEX_HH
+#define TRIGRAM_INDEX_HH
+
+#include "regex.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* A trigram index records, for every three-byte sequence that occurs in a
+ * fixed set of documents, which documents contain it.  Any match of a regex
+ * contains certain trigrams (the query planner works out which), so only the
+ * documents that contain them need to be searched.
+ */
+
+
+/* The trigrams that any match of a regex must contain, as an AND of ORs:  a
+ * document can only match if, for every clause, it contains at least one of
+ * the trigrams in that clause.  With no clauses, every document is a
+ * candidate.  Trigrams are packed as (c0 << 16) | (c1 << 8) | c2.
+ */
+struct TrigramQuery {
+    vector<vector<uint32_t>> clauses;
+
+    bool matchesAll() const { return clauses.empty(); }
+};
+
+
+// A run of operators is only turned into a clause if it allows at most this
+// many trigrams; wider clauses cost more to look up than they save.
+const int MAX_TRIGRAM_ALTERNATIVES = 16;
+
+TrigramQuery planTrigramQuery(const vector<RegexOperator *> &regex);
+
+
+/* Index files can be used directly from an mmap.  As with DFA files, every
+ * reference is a byte offset from the start of the file and integers are in
+ * the byte order of the writer.
+ *
+ *   TrigramIndexHeader
+ *   TrigramIndexDoc[numDocs]
+ *   TrigramIndexEntry[numTrigrams], sorted by trigram
+ *   the document paths
+ *   the posting lists
+ *
+ * A posting list is the increasing list of documents that contain a trigram,
+ * stored as gaps between document numbers, each in a variable-length
+ * encoding of 7 bits per byte with the high bit set on all but the last
+ * byte.  Most gaps fit in one byte.
+ */
+
+const char TRIGRAM_INDEX_MAGIC[8] = { 'L', 'S', 'T', 'R', 'I', 0, 0, 0 };
+const uint32_t TRIGRAM_INDEX_VERSION = 1;
+const uint32_t TRIGRAM_INDEX_BYTE_ORDER = 0x01020304;
+
+struct TrigramIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint32_t numDocs;
+    uint32_t numTrigrams;
+};
+
+struct TrigramIndexDoc {
+    uint64_t pathOffset;
+    uint64_t size;
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+struct TrigramIndexEntry {
+    uint64_t postingOffset;
+    uint32_t postingLength;
+    uint32_t trigram;
+    uint32_t numDocs;
+    uint32_t reserved;
+};
+
+
+/* Reads every document and writes an index of them to path.  Returns false
+ * and describes the problem in error if a document cannot be read or the
+ * index cannot be written.
+ */
+bool writeTrigramIndex(const string &path, const vector<string> &docPaths,
+                       string &error);
+
+
+/* A read-only, memory-mapped trigram index. */
+class TrigramIndex {
+    void *base;
+    size_t size;
+
+    const TrigramIndexHeader *header;
+    const TrigramIndexDoc *docs;
+    const TrigramIndexEntry *entries;
+
+    // The mapping is not copyable.
+    TrigramIndex(const TrigramIndex &);
+    TrigramIndex & operator=(const TrigramIndex &);
+
+    bool validate(string &error);
+    const TrigramIndexEntry * findEntry(uint32_t trigram) const;
+    void decodePostings(const TrigramIndexEntry &entry,
+                        vector<uint32_t> &out) const;
+    void clauseDocs(const vector<uint32_t> &clause,
+                    vector<uint32_t> &out) const;
+
+public:
+    TrigramIndex();
+    ~TrigramIndex();
+
+    bool open(const string &path, string &error);
+    void close();
+
+    int numDocs() const;
+    string getDocPath(int i) const;
+    uint64_t getDocSize(int i) const;
+
+    // The number of documents that contain the trigram.
+    int countDocs(uint32_t trigram) const;
+
+    void candidates(const TrigramQuery &query, vector<int> &docs) const;
+};
+
+
+#endif // TRIGRAM_INDEX_HH
@@ -0,0 +1,90 @@
+#include "compiled-regex.hh"
+#include "trigram-index.hh"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+
+/* This program searches the documents in a trigram index for a regex.  The
+ * query planner picks the trigrams every match must contain, the index
+ * narrows the documents down to those that contain them, and only those
+ * candidates are read and searched.  The first match in each matching
+ * document is printed.
+ */
+
+
+/*! Prints a usage statement for the program. */
+void printUsage(char *name)
+{
+    cerr << "Usage: " << name << " [-i] INDEX-FILE PATTERN" << endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    int flags = 0;
+    int arg = 1;
+    if(argc > 1 && string(argv[1]) == "-i")
+    {
+        flags |= REGEX_CASE_INSENSITIVE;
+        arg++;
+    }
+
+    if(argc - arg != 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TrigramIndex index;
+    string error;
+    if(!index.open(argv[arg], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+
+    vector<RegexOperator *> regex = parseRegex(argv[arg + 1], flags);
+    TrigramQuery query = planTrigramQuery(regex);
+    clearRegex(regex);
+
+    vector<int> docs;
+    index.candidates(query, docs);
+
+    CompiledRegex compiled(argv[arg + 1], flags);
+    int matched = 0;
+    for(int d : docs)
+    {
+        string path = index.getDocPath(d);
+        ifstream in(path, ios::binary);
+        if(!in)
+        {
+            cerr << "Could not open " << path << endl;
+            continue;
+        }
+
+        stringstream contents;
+        contents << in.rdbuf();
+        string text = contents.str();
+        if(text.length() != index.getDocSize(d))
+        {
+            cerr << path << " has changed since it was indexed" << endl;
+        }
+
+        Range r = compiled.find(text);
+        if(r.start != -1)
+        {
+            cout << path << ":" << r.start << ": "
+                 << text.substr(r.start, r.end - r.start) << endl;
+            matched++;
+        }
+    }
+
+    cerr << query.clauses.size() << " trigram clauses, " << docs.size()
+         << " of " << index.numDocs() << " documents searched, " << matched
+         << " matched" << endl;
+    return matched > 0 ? 0 : 1;
+}